@@ -0,0 +1,154 @@
+#include "alloc.h"
+
+#include <assert.h>
+#include <raylib.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+// keeps the memory after it aligned like MemAlloc() returned it
+typedef union AllocHeader {
+    struct {
+        size_t size;
+        AllocTag tag;
+    } h;
+    max_align_t align;
+} AllocHeader;
+
+typedef struct AllocCounters {
+    atomic_size_t allocs;
+    atomic_size_t resizes;
+    atomic_size_t frees;
+    atomic_size_t bytes;
+    atomic_size_t peakBytes;
+} AllocCounters;
+
+static AllocCounters tags[ALLOC_TAGS];
+static AllocCounters total;
+
+static const char *TAG_NAMES[ALLOC_TAGS] = {
+    [ALLOC_ENTITIES] = "entities",
+    [ALLOC_LEVEL] = "level",
+    [ALLOC_RENDER] = "render",
+    [ALLOC_OTHER] = "other",
+};
+
+static size_t load(atomic_size_t *x)
+{
+    return atomic_load_explicit(x, memory_order_relaxed);
+}
+
+static void add(atomic_size_t *x, size_t n)
+{
+    atomic_fetch_add_explicit(x, n, memory_order_relaxed);
+}
+
+static void grow(AllocCounters *c, size_t size)
+{
+    size_t bytes =
+        atomic_fetch_add_explicit(&c->bytes, size, memory_order_relaxed) +
+        size;
+    size_t peak = load(&c->peakBytes);
+    while (bytes > peak &&
+           !atomic_compare_exchange_weak_explicit(&c->peakBytes, &peak, bytes,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+static void shrink(AllocCounters *c, size_t size)
+{
+    atomic_fetch_sub_explicit(&c->bytes, size, memory_order_relaxed);
+}
+
+void *allocMem(AllocTag tag, size_t size)
+{
+    assert(tag >= 0 && tag < ALLOC_TAGS);
+
+    AllocHeader *header = MemAlloc(sizeof(*header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->h.size = size;
+    header->h.tag = tag;
+
+    add(&tags[tag].allocs, 1);
+    add(&total.allocs, 1);
+    grow(&tags[tag], size);
+    grow(&total, size);
+    return header + 1;
+}
+
+void *allocResize(AllocTag tag, void *p, size_t size)
+{
+    if (p == NULL) {
+        return allocMem(tag, size);
+    }
+
+    AllocHeader *header = (AllocHeader *)p - 1;
+    assert(header->h.tag == tag && "resized with a different tag");
+    size_t old = header->h.size;
+
+    header = MemRealloc(header, sizeof(*header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->h.size = size;
+
+    add(&tags[tag].resizes, 1);
+    add(&total.resizes, 1);
+    if (size > old) {
+        grow(&tags[tag], size - old);
+        grow(&total, size - old);
+    } else {
+        shrink(&tags[tag], old - size);
+        shrink(&total, old - size);
+    }
+    return header + 1;
+}
+
+void allocFree(void *p)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    AllocHeader *header = (AllocHeader *)p - 1;
+    AllocTag tag = header->h.tag;
+    add(&tags[tag].frees, 1);
+    add(&total.frees, 1);
+    shrink(&tags[tag], header->h.size);
+    shrink(&total, header->h.size);
+    MemFree(header);
+}
+
+static AllocStats snapshot(AllocCounters *c)
+{
+    return (AllocStats){
+        .allocs = load(&c->allocs),
+        .resizes = load(&c->resizes),
+        .frees = load(&c->frees),
+        .bytes = load(&c->bytes),
+        .peakBytes = load(&c->peakBytes),
+    };
+}
+
+AllocStats allocStats() { return snapshot(&total); }
+
+AllocStats allocTagStats(AllocTag tag) { return snapshot(&tags[tag]); }
+
+const char *allocTagName(AllocTag tag) { return TAG_NAMES[tag]; }
+
+size_t allocReportLeaks()
+{
+    size_t live = 0;
+    for (int i = 0; i < ALLOC_TAGS; i += 1) {
+        AllocStats s = allocTagStats(i);
+        if (s.allocs == s.frees) {
+            continue;
+        }
+        fprintf(stderr, "leak: %zu %s allocations, %zu bytes\n",
+                s.allocs - s.frees, TAG_NAMES[i], s.bytes);
+        live += s.allocs - s.frees;
+    }
+    return live;
+}
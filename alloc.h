@@ -0,0 +1,43 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+// Heap allocations of the game, zeroed like MemAlloc()
+//
+// Every allocation is tagged with the subsystem that owns it and carries a
+// small header with its tag and size, so the live bytes and the peak of each
+// subsystem are known at any time and whatever is still live at exit can be
+// reported as a leak. Safe from any thread, the counters are relaxed atomics.
+
+typedef enum AllocTag {
+    ALLOC_ENTITIES = 0, // entity stores and their snapshots
+    ALLOC_LEVEL,
+    ALLOC_RENDER, // quad batches and tile caches
+    ALLOC_OTHER,
+    ALLOC_TAGS,
+} AllocTag;
+
+void *allocMem(AllocTag tag, size_t size);
+// p must have been allocated with the same tag, NULL allocates
+void *allocResize(AllocTag tag, void *p, size_t size);
+void allocFree(void *p);
+
+typedef struct AllocStats {
+    size_t allocs; // allocMem() and allocResize() of NULL
+    size_t resizes;
+    size_t frees;
+    size_t bytes; // live
+    size_t peakBytes;
+} AllocStats;
+
+// everything together, the peak is the peak of the sum
+AllocStats allocStats();
+AllocStats allocTagStats(AllocTag tag);
+const char *allocTagName(AllocTag tag);
+
+// prints the tags that still have live allocations, returns how many
+// allocations are live
+size_t allocReportLeaks();
+
+#endif
@@ -0,0 +1,262 @@
+// Microbenchmarks of the hot functions of the game
+//
+// Every benchmark is warmed up, then calibrated so one sample runs for about
+// SAMPLE_NS and measured over SAMPLES samples. The median ns/op is reported
+// with the median absolute deviation of the samples, which a few preempted
+// samples do not move, and the allocations per operation counted by alloc.h.
+//
+//   leep-bench [--json] [--filter substring]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "binlog.h"
+#include "entity.h"
+#include "messages.h"
+#include "overlay.h"
+#include "profile.h"
+
+#define SAMPLES 31
+#define SAMPLE_NS 10000000ull
+#define WARMUP_NS 50000000ull
+#define STORE_LEN 4096
+
+typedef struct Bench {
+    const char *name;
+    void (*setup)();
+    void (*run)(size_t iters);
+} Bench;
+
+typedef struct BenchResult {
+    double nsPerOp;
+    double madNs;
+    double allocsPerOp;
+    size_t iters;
+} BenchResult;
+
+// results are written here so the compiler cannot drop the work
+static volatile float sink = 0;
+
+static void polateRun(size_t iters)
+{
+    Vector2 v = {0, 0};
+    Vector2 dest = {1, 1};
+    for (size_t i = 0; i < iters; i += 1) {
+        v = Vector2Polate(v, dest, 0.5f);
+        dest.x = -dest.x;
+    }
+    sink = v.x + v.y;
+}
+
+static Player player;
+
+static void playerSetup()
+{
+    player = (Player){.maxVel = 10, .radius = 10};
+}
+
+static void playerRun(size_t iters)
+{
+    for (size_t i = 0; i < iters; i += 1) {
+        // keep it transitioning instead of sitting at its target
+        if (player.velTransitionTime == 0) {
+            Vector2 direction = {player.targetVel.x < 0 ? 5 : -5, 2};
+            playerMove(&player, direction);
+        }
+        playerUpdate(&player);
+    }
+    sink = player.pos.x;
+}
+
+static EntityStore store;
+
+static void storeSetup()
+{
+    if (store.capacity == 0) {
+        entityStoreInit(&store, STORE_LEN);
+    }
+    entityStoreClear(&store);
+    for (size_t i = 0; i < STORE_LEN; i += 1) {
+        size_t e = entityAdd(&store, (Player){.maxVel = 10, .radius = 10});
+        playersMove(&store, e, (Vector2){(float)(i % 7) - 3, 1});
+    }
+}
+
+static void storeRun(size_t iters)
+{
+    for (size_t i = 0; i < iters; i += 1) {
+        playersUpdate(&store, store.len);
+    }
+    sink = store.pos[0].x;
+}
+
+static void messagesSetup() { messagesClear(); }
+
+static void putGetRun(size_t iters)
+{
+    for (size_t i = 0; i < iters; i += 1) {
+        messagesPut("mouse clicked v = {12.00, 34.00}");
+        sink = (float)messagesGet()[0];
+    }
+}
+
+static void newRun(size_t iters)
+{
+    // the queue stays full, which is the common case while clicking around
+    for (size_t i = 0; i < iters; i += 1) {
+        messagesNew("mouse clicked v = {%.2f, %.2f}", (double)i, 34.0);
+    }
+}
+
+static int measureMonospace(const char *text, int fontSize)
+{
+    return (int)strlen(text) * fontSize / 2;
+}
+
+static void overlaySetup()
+{
+    messagesClear();
+    for (int i = 0; i < MAX_MESSAGES_LEN; i += 1) {
+        messagesNew("mouse clicked v = {%.2f, %.2f}", (double)i, 34.0);
+    }
+}
+
+static void overlayRun(size_t iters)
+{
+    static OverlayLine lines[MAX_OVERLAY_LINES];
+    for (size_t i = 0; i < iters; i += 1) {
+        sink = overlayLayout(lines, 2160, 20, measureMonospace);
+    }
+}
+
+static const Bench BENCHES[] = {
+    {"Vector2Polate", NULL, polateRun},
+    {"playerUpdate", playerSetup, playerRun},
+    {"playersUpdate/4096", storeSetup, storeRun},
+    {"messagesPut+Get", messagesSetup, putGetRun},
+    {"messagesNew", messagesSetup, newRun},
+    {"overlayLayout/100", overlaySetup, overlayRun},
+};
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t timeRun(const Bench *b, size_t iters)
+{
+    uint64_t start = profileNowNs();
+    b->run(iters);
+    return profileNowNs() - start;
+}
+
+static BenchResult benchRun(const Bench *b)
+{
+    if (b->setup != NULL) {
+        b->setup();
+    }
+
+    // double the iterations until a run is long enough to time, which also
+    // warms the caches and the branch predictors up
+    size_t iters = 1;
+    uint64_t warmup = 0;
+    uint64_t elapsed = timeRun(b, iters);
+    while (elapsed < SAMPLE_NS / 4 || warmup < WARMUP_NS) {
+        warmup += elapsed;
+        if (elapsed < SAMPLE_NS / 4) {
+            iters *= 2;
+        }
+        elapsed = timeRun(b, iters);
+    }
+    iters = (size_t)((double)iters * SAMPLE_NS / (double)elapsed) + 1;
+
+    double samples[SAMPLES];
+    AllocStats before = allocStats();
+    for (int i = 0; i < SAMPLES; i += 1) {
+        samples[i] = (double)timeRun(b, iters) / (double)iters;
+    }
+    AllocStats after = allocStats();
+
+    qsort(samples, SAMPLES, sizeof(*samples), compareDouble);
+    double median = samples[SAMPLES / 2];
+    for (int i = 0; i < SAMPLES; i += 1) {
+        samples[i] = samples[i] > median ? samples[i] - median
+                                         : median - samples[i];
+    }
+    qsort(samples, SAMPLES, sizeof(*samples), compareDouble);
+
+    return (BenchResult){
+        .nsPerOp = median,
+        .madNs = samples[SAMPLES / 2],
+        .allocsPerOp = (double)(after.allocs - before.allocs) /
+                       ((double)iters * SAMPLES),
+        .iters = iters,
+    };
+}
+
+int main(int argc, char **argv)
+{
+    bool json = false;
+    const char *filter = NULL;
+
+    for (int i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--filter substring]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    // messagesNew() does most of its work in binlogWrite(), which does
+    // nothing until the log runs. Without a file or echo the writer thread
+    // only drains the rings, a burst that fills one between its polls drops
+    // like it would in the game.
+    if (!binlogStart(NULL, false)) {
+        fprintf(stderr, "failed to start the log\n");
+        return 1;
+    }
+
+    if (json) {
+        printf("{\"samples\": %i, \"benchmarks\": [", SAMPLES);
+    } else {
+        printf("%-20s %12s %10s %12s\n", "benchmark", "ns/op", "mad",
+               "allocs/op");
+    }
+
+    bool first = true;
+    for (size_t i = 0; i < sizeof(BENCHES) / sizeof(*BENCHES); i += 1) {
+        const Bench *b = &BENCHES[i];
+        if (filter != NULL && strstr(b->name, filter) == NULL) {
+            continue;
+        }
+
+        BenchResult r = benchRun(b);
+        if (json) {
+            printf("%s\n  {\"name\": \"%s\", \"ns_per_op\": %.3f, "
+                   "\"mad_ns\": %.3f, \"allocs_per_op\": %.3f, "
+                   "\"iterations\": %zu}",
+                   first ? "" : ",", b->name, r.nsPerOp, r.madNs,
+                   r.allocsPerOp, r.iters);
+        } else {
+            printf("%-20s %12.2f %10.2f %12.3f\n", b->name, r.nsPerOp,
+                   r.madNs, r.allocsPerOp);
+        }
+        first = false;
+    }
+
+    if (json) {
+        printf("\n]}\n");
+    }
+
+    entityStoreFree(&store);
+    binlogStop();
+    return 0;
+}
@@ -0,0 +1,631 @@
+#include "binlog.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+#include "spsc.h"
+
+static const char MAGIC[4] = {'L', 'L', 'O', 'G'};
+#define FORMAT_TAG 1
+#define MESSAGE_TAG 2
+// longest line echoed or expanded
+#define MAX_TEXT_LEN 512
+#define WRITER_SLEEP_NS 2000000
+
+typedef enum ArgKind {
+    ARG_INT,
+    ARG_UINT,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+} ArgKind;
+
+// how va_arg has to read an integer
+typedef enum ArgSize {
+    SIZE_INT,
+    SIZE_LONG,
+    SIZE_LONG_LONG,
+    SIZE_SIZE_T,
+    SIZE_INTMAX,
+    SIZE_PTRDIFF,
+} ArgSize;
+
+typedef struct Format {
+    const char *fmt;
+    uint8_t kinds[BINLOG_MAX_ARGS];
+    uint8_t sizes[BINLOG_MAX_ARGS];
+    int argc;
+    bool supported;
+} Format;
+
+typedef struct Record {
+    uint64_t timestamp;
+    uint16_t format;
+    uint16_t len;
+    unsigned char args[BINLOG_RECORD_ARGS];
+} Record;
+
+typedef struct Ring {
+    SpscRing ring;
+    Record records[BINLOG_RING_LEN];
+} Ring;
+
+// formats are only ever added, an id below formatsLen is immutable
+static Format formats[BINLOG_MAX_FORMATS];
+static atomic_int formatsLen = 0;
+static pthread_mutex_t formatsLock = PTHREAD_MUTEX_INITIALIZER;
+// what cannot be stored as arguments is logged as text, binlogStart()
+// registers this first so the fallback always has an id
+static const char TEXT_FORMAT[] = "%s";
+#define TEXT_FORMAT_ID 0
+
+static Ring rings[BINLOG_MAX_THREADS];
+static atomic_int ringsLen = 0;
+static _Thread_local Ring *threadRing = NULL;
+static _Thread_local bool threadRingFailed = false;
+
+static atomic_size_t dropped = 0;
+
+static pthread_t writer;
+static atomic_bool running = false;
+static atomic_bool stopping = false;
+static FILE *file = NULL;
+static bool echo = false;
+static int formatsWritten = 0;
+
+// One conversion of a format string, returns the length of the spec or 0
+// when it is not one binlog can store. *kind is left alone for %%.
+static size_t parseConversion(const char *spec, ArgKind *kind, ArgSize *size,
+                              bool *isArg)
+{
+    const char *p = spec + 1;
+    if (*p == '%') {
+        *isArg = false;
+        return 2;
+    }
+    *isArg = true;
+
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789");
+    if (*p == '.') {
+        p += 1;
+        p += strspn(p, "0123456789");
+    }
+
+    *size = SIZE_INT;
+    if (p[0] == 'h') {
+        p += p[1] == 'h' ? 2 : 1;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        *size = SIZE_LONG_LONG;
+        p += 2;
+    } else if (p[0] == 'l') {
+        *size = SIZE_LONG;
+        p += 1;
+    } else if (p[0] == 'z') {
+        *size = SIZE_SIZE_T;
+        p += 1;
+    } else if (p[0] == 'j') {
+        *size = SIZE_INTMAX;
+        p += 1;
+    } else if (p[0] == 't') {
+        *size = SIZE_PTRDIFF;
+        p += 1;
+    }
+
+    switch (*p) {
+    case 'd':
+    case 'i':
+    case 'c':
+        *kind = ARG_INT;
+        break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        *kind = ARG_UINT;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        *kind = ARG_DOUBLE;
+        break;
+    case 's':
+        if (*size != SIZE_INT) {
+            return 0; // wide strings
+        }
+        *kind = ARG_STRING;
+        break;
+    case 'p':
+        *kind = ARG_POINTER;
+        break;
+    default:
+        // '*' widths, %n, long doubles
+        return 0;
+    }
+    return (size_t)(p - spec) + 1;
+}
+
+static Format formatParse(const char *fmt)
+{
+    Format f = {.fmt = fmt, .supported = true};
+    for (const char *p = strchr(fmt, '%'); p != NULL; p = strchr(p, '%')) {
+        ArgKind kind = ARG_INT;
+        ArgSize size = SIZE_INT;
+        bool isArg = false;
+        size_t len = parseConversion(p, &kind, &size, &isArg);
+        if (len == 0 || (isArg && f.argc == BINLOG_MAX_ARGS)) {
+            f.supported = false;
+            return f;
+        }
+        if (isArg) {
+            f.kinds[f.argc] = (uint8_t)kind;
+            f.sizes[f.argc] = (uint8_t)size;
+            f.argc += 1;
+        }
+        p += len;
+    }
+    return f;
+}
+
+// the id of fmt, registering it the first time, -1 when the table is full
+static int formatId(const char *fmt)
+{
+    int len = atomic_load_explicit(&formatsLen, memory_order_acquire);
+    for (int i = 0; i < len; i += 1) {
+        if (formats[i].fmt == fmt) {
+            return i;
+        }
+    }
+
+    pthread_mutex_lock(&formatsLock);
+    // another thread may have added it meanwhile
+    len = atomic_load_explicit(&formatsLen, memory_order_relaxed);
+    int id = -1;
+    for (int i = 0; i < len && id < 0; i += 1) {
+        if (formats[i].fmt == fmt) {
+            id = i;
+        }
+    }
+    if (id < 0 && len < BINLOG_MAX_FORMATS) {
+        formats[len] = formatParse(fmt);
+        id = len;
+        atomic_store_explicit(&formatsLen, len + 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&formatsLock);
+    return id;
+}
+
+static Ring *ringClaim()
+{
+    if (threadRing != NULL || threadRingFailed) {
+        return threadRing;
+    }
+
+    int i = atomic_fetch_add(&ringsLen, 1);
+    if (i >= BINLOG_MAX_THREADS) {
+        atomic_fetch_sub(&ringsLen, 1);
+        threadRingFailed = true;
+        return NULL;
+    }
+    spscInit(&rings[i].ring, BINLOG_RING_LEN);
+    threadRing = &rings[i];
+    return threadRing;
+}
+
+static bool putBytes(Record *r, const void *data, size_t size)
+{
+    if (r->len + size > BINLOG_RECORD_ARGS) {
+        return false;
+    }
+    memcpy(&r->args[r->len], data, size);
+    r->len += (uint16_t)size;
+    return true;
+}
+
+static int64_t readInt(ArgSize size, va_list *args)
+{
+    switch (size) {
+    case SIZE_LONG:
+        return va_arg(*args, long);
+    case SIZE_LONG_LONG:
+        return va_arg(*args, long long);
+    case SIZE_SIZE_T:
+        return (int64_t)va_arg(*args, size_t);
+    case SIZE_INTMAX:
+        return va_arg(*args, intmax_t);
+    case SIZE_PTRDIFF:
+        return va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, int);
+    }
+}
+
+static uint64_t readUint(ArgSize size, va_list *args)
+{
+    switch (size) {
+    case SIZE_LONG:
+        return va_arg(*args, unsigned long);
+    case SIZE_LONG_LONG:
+        return va_arg(*args, unsigned long long);
+    case SIZE_SIZE_T:
+        return va_arg(*args, size_t);
+    case SIZE_INTMAX:
+        return va_arg(*args, uintmax_t);
+    case SIZE_PTRDIFF:
+        return (uint64_t)va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, unsigned int);
+    }
+}
+
+// false when the arguments do not fit the record
+static bool recordArgs(Record *r, const Format *f, va_list *args)
+{
+    for (int i = 0; i < f->argc; i += 1) {
+        bool ok = true;
+        switch (f->kinds[i]) {
+        case ARG_INT: {
+            int64_t v = readInt(f->sizes[i], args);
+            ok = putBytes(r, &v, sizeof(v));
+            break;
+        }
+        case ARG_UINT: {
+            uint64_t v = readUint(f->sizes[i], args);
+            ok = putBytes(r, &v, sizeof(v));
+            break;
+        }
+        case ARG_DOUBLE: {
+            double v = va_arg(*args, double);
+            ok = putBytes(r, &v, sizeof(v));
+            break;
+        }
+        case ARG_POINTER: {
+            uint64_t v = (uint64_t)(uintptr_t)va_arg(*args, void *);
+            ok = putBytes(r, &v, sizeof(v));
+            break;
+        }
+        case ARG_STRING: {
+            const char *s = va_arg(*args, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            size_t room = BINLOG_RECORD_ARGS - r->len - sizeof(uint16_t);
+            size_t len = strlen(s);
+            // long strings are cut rather than dropping the message
+            uint16_t stored = (uint16_t)(len < room ? len : room);
+            ok = putBytes(r, &stored, sizeof(stored)) &&
+                 putBytes(r, s, stored);
+            break;
+        }
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void binlogWrite(const char *fmt, va_list args)
+{
+    if (!atomic_load_explicit(&running, memory_order_relaxed)) {
+        return;
+    }
+    Ring *ring = ringClaim();
+    size_t slot = 0;
+    if (ring == NULL || !spscWriteSlot(&ring->ring, &slot)) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    Record *r = &ring->records[slot];
+    r->timestamp = profileNowNs();
+    r->len = 0;
+
+    va_list copy;
+    va_copy(copy, args);
+    int id = formatId(fmt);
+    bool stored = id >= 0 && formats[id].supported &&
+                  recordArgs(r, &formats[id], &copy);
+    va_end(copy);
+
+    if (!stored) {
+        // formatted here and logged as the text of TEXT_FORMAT, from a copy
+        // too since the caller's args must come back unused
+        char text[BINLOG_RECORD_ARGS - sizeof(uint16_t)];
+        va_copy(copy, args);
+        vsnprintf(text, sizeof(text), fmt, copy);
+        va_end(copy);
+        r->len = 0;
+        id = TEXT_FORMAT_ID;
+        uint16_t len = (uint16_t)strlen(text);
+        putBytes(r, &len, sizeof(len));
+        putBytes(r, text, len);
+    }
+    r->format = (uint16_t)id;
+    spscPublish(&ring->ring);
+}
+
+size_t binlogDropped() { return atomic_load(&dropped); }
+
+// Expand one message, args are checked against len so a corrupt file
+// prints garbage instead of reading out of bounds
+static void expand(char *out, size_t size, const char *fmt,
+                   const unsigned char *args, size_t len)
+{
+    size_t used = 0;
+    size_t at = 0;
+    out[0] = '\0';
+
+    for (const char *p = fmt; *p != '\0' && used + 1 < size;) {
+        if (*p != '%') {
+            out[used] = *p;
+            used += 1;
+            out[used] = '\0';
+            p += 1;
+            continue;
+        }
+
+        ArgKind kind = ARG_INT;
+        ArgSize argSize = SIZE_INT;
+        bool isArg = false;
+        size_t specLen = parseConversion(p, &kind, &argSize, &isArg);
+        if (specLen == 0) {
+            break;
+        }
+
+        // the spec without its length modifier, integers are printed as
+        // 64 bit whatever they were logged as
+        char spec[32];
+        size_t n = 0;
+        for (size_t i = 0; i < specLen && n + 3 < sizeof(spec); i += 1) {
+            if (i + 1 < specLen && strchr("hlzjt", p[i]) != NULL) {
+                continue;
+            }
+            if (i + 1 == specLen && (kind == ARG_INT || kind == ARG_UINT) &&
+                p[i] != 'c') {
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+            }
+            spec[n++] = p[i];
+        }
+        spec[n] = '\0';
+        p += specLen;
+
+        char *dest = out + used;
+        size_t room = size - used;
+        int written = 0;
+        if (!isArg) {
+            written = snprintf(dest, room, "%%");
+        } else if (kind == ARG_STRING) {
+            uint16_t strLen = 0;
+            if (at + sizeof(strLen) > len) {
+                break;
+            }
+            memcpy(&strLen, &args[at], sizeof(strLen));
+            at += sizeof(strLen);
+            if (at + strLen > len) {
+                break;
+            }
+            char str[BINLOG_RECORD_ARGS];
+            memcpy(str, &args[at], strLen);
+            str[strLen] = '\0';
+            at += strLen;
+            written = snprintf(dest, room, spec, str);
+        } else {
+            uint64_t v = 0;
+            if (at + sizeof(v) > len) {
+                break;
+            }
+            memcpy(&v, &args[at], sizeof(v));
+            at += sizeof(v);
+
+            double d;
+            int64_t i;
+            switch (kind) {
+            case ARG_INT:
+                memcpy(&i, &v, sizeof(i));
+                if (spec[n - 1] == 'c') {
+                    written = snprintf(dest, room, spec, (int)i);
+                } else {
+                    written = snprintf(dest, room, spec, (long long)i);
+                }
+                break;
+            case ARG_UINT:
+                written = snprintf(dest, room, spec, (unsigned long long)v);
+                break;
+            case ARG_DOUBLE:
+                memcpy(&d, &v, sizeof(d));
+                written = snprintf(dest, room, spec, d);
+                break;
+            default:
+                written = snprintf(dest, room, spec, (void *)(uintptr_t)v);
+                break;
+            }
+        }
+        if (written < 0) {
+            break;
+        }
+        used += (size_t)written < room ? (size_t)written : room - 1;
+    }
+}
+
+static void writerFlushRing(Ring *ring)
+{
+    size_t slot;
+    while (spscReadSlot(&ring->ring, &slot)) {
+        const Record *r = &ring->records[slot];
+
+        if (echo) {
+            char text[MAX_TEXT_LEN];
+            expand(text, sizeof(text), formats[r->format].fmt, r->args,
+                   r->len);
+            puts(text);
+        }
+        if (file != NULL) {
+            for (; formatsWritten <= r->format; formatsWritten += 1) {
+                const char *fmt = formats[formatsWritten].fmt;
+                uint8_t tag = FORMAT_TAG;
+                uint16_t id = (uint16_t)formatsWritten;
+                uint16_t len = (uint16_t)strlen(fmt);
+                fwrite(&tag, sizeof(tag), 1, file);
+                fwrite(&id, sizeof(id), 1, file);
+                fwrite(&len, sizeof(len), 1, file);
+                fwrite(fmt, len, 1, file);
+            }
+            uint8_t tag = MESSAGE_TAG;
+            fwrite(&tag, sizeof(tag), 1, file);
+            fwrite(&r->format, sizeof(r->format), 1, file);
+            fwrite(&r->timestamp, sizeof(r->timestamp), 1, file);
+            fwrite(&r->len, sizeof(r->len), 1, file);
+            fwrite(r->args, r->len, 1, file);
+        }
+        spscRelease(&ring->ring);
+    }
+}
+
+static void writerFlush()
+{
+    int len = atomic_load(&ringsLen);
+    if (len > BINLOG_MAX_THREADS) {
+        len = BINLOG_MAX_THREADS;
+    }
+    for (int i = 0; i < len; i += 1) {
+        writerFlushRing(&rings[i]);
+    }
+    if (echo) {
+        fflush(stdout);
+    }
+}
+
+static void *writerMain(void *arg)
+{
+    (void)arg;
+
+    // polls instead of being woken up so logging never makes a syscall
+    const struct timespec sleep = {0, WRITER_SLEEP_NS};
+    while (!atomic_load(&stopping)) {
+        writerFlush();
+        nanosleep(&sleep, NULL);
+    }
+    writerFlush();
+    return NULL;
+}
+
+bool binlogStart(const char *path, bool echoText)
+{
+    if (atomic_load(&running)) {
+        return true;
+    }
+
+    file = NULL;
+    if (path != NULL) {
+        file = fopen(path, "wb");
+        if (file == NULL) {
+            return false;
+        }
+        uint32_t version = BINLOG_VERSION;
+        uint64_t start = profileNowNs();
+        fwrite(MAGIC, sizeof(MAGIC), 1, file);
+        fwrite(&version, sizeof(version), 1, file);
+        fwrite(&start, sizeof(start), 1, file);
+    }
+    echo = echoText;
+    formatsWritten = 0;
+    // formats stay registered across restarts, so this is only added once
+    formatId(TEXT_FORMAT);
+    atomic_store(&stopping, false);
+
+    if (pthread_create(&writer, NULL, writerMain, NULL) != 0) {
+        if (file != NULL) {
+            fclose(file);
+            file = NULL;
+        }
+        return false;
+    }
+    atomic_store(&running, true);
+    return true;
+}
+
+void binlogStop()
+{
+    if (!atomic_load(&running)) {
+        return;
+    }
+    atomic_store(&running, false);
+    atomic_store(&stopping, true);
+    pthread_join(writer, NULL);
+
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+static bool get(FILE *in, void *data, size_t size)
+{
+    return fread(data, size, 1, in) == 1;
+}
+
+bool binlogExpand(const char *path, FILE *out)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t start = 0;
+    if (!get(in, magic, sizeof(magic)) ||
+        memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !get(in, &version, sizeof(version)) || version != BINLOG_VERSION ||
+        !get(in, &start, sizeof(start))) {
+        fclose(in);
+        return false;
+    }
+
+    static char fmts[BINLOG_MAX_FORMATS][MAX_TEXT_LEN];
+    bool defined[BINLOG_MAX_FORMATS] = {0};
+    bool ok = true;
+
+    uint8_t tag;
+    while (ok && get(in, &tag, sizeof(tag))) {
+        uint16_t id = 0;
+        uint16_t len = 0;
+        if (tag == FORMAT_TAG) {
+            ok = get(in, &id, sizeof(id)) && get(in, &len, sizeof(len)) &&
+                 id < BINLOG_MAX_FORMATS && len < MAX_TEXT_LEN &&
+                 (len == 0 || get(in, fmts[id], len));
+            if (ok) {
+                fmts[id][len] = '\0';
+                defined[id] = true;
+            }
+        } else if (tag == MESSAGE_TAG) {
+            uint64_t timestamp = 0;
+            unsigned char args[BINLOG_RECORD_ARGS];
+            ok = get(in, &id, sizeof(id)) &&
+                 get(in, &timestamp, sizeof(timestamp)) &&
+                 get(in, &len, sizeof(len)) && id < BINLOG_MAX_FORMATS &&
+                 defined[id] && len <= BINLOG_RECORD_ARGS &&
+                 (len == 0 || get(in, args, len));
+            if (ok) {
+                char text[MAX_TEXT_LEN];
+                expand(text, sizeof(text), fmts[id], args, len);
+                fprintf(out, "[%10.6f] %s\n", (timestamp - start) / 1e9, text);
+            }
+        } else {
+            ok = false;
+        }
+    }
+
+    fclose(in);
+    return ok;
+}
@@ -0,0 +1,50 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Binary log of formatted messages, written off the calling thread
+//
+// binlogWrite() stores the id of the format string, a timestamp and the raw
+// arguments into a ring owned by the calling thread, it never allocates or
+// formats. It only blocks the first time a format is used, registering it
+// takes a lock another thread registering a format may hold. A background
+// thread moves the records into a compact binary file and, when echo is on,
+// expands them to text on stdout. Formats are identified by their address so
+// they must be string literals, a format the log cannot store the arguments
+// of is formatted on the spot and logged as text.
+//
+// A record that finds its thread's ring full, or a thread that finds no free
+// ring, is lost and counted in binlogDropped(). There is a ring for the
+// render thread and every message producer.
+//
+// The file starts with "LLOG", a u32 version and the u64 start time in ns.
+// Each format is defined before its first use by a u8 1, a u16 id, a u16
+// length and its bytes. A message is a u8 2, the u16 format id, a u64
+// timestamp, a u16 length and the arguments: 8 bytes per integer, double or
+// pointer and a u16 length then the bytes for a string.
+#define BINLOG_VERSION 1
+#define BINLOG_RING_LEN 512
+#define BINLOG_RECORD_ARGS 240
+#define BINLOG_MAX_THREADS 73
+#define BINLOG_MAX_FORMATS 256
+#define BINLOG_MAX_ARGS 8
+
+// path may be NULL to only echo, false when the file or the thread failed
+bool binlogStart(const char *path, bool echo);
+// writes out everything logged so far
+void binlogStop();
+
+// args is only read through copies, the caller can still use it after
+void binlogWrite(const char *fmt, va_list args);
+// records lost to full rings or to threads without one
+size_t binlogDropped();
+
+// expand a log file to text, one message per line prefixed by its time
+bool binlogExpand(const char *path, FILE *out);
+
+#endif
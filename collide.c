@@ -0,0 +1,298 @@
+#include "collide.h"
+
+#include <float.h>
+#include <math.h>
+#include <raymath.h>
+#include <stddef.h>
+
+#define MAX_SLIDES 3
+// kept between the circle and what it touches so the next move does not
+// start out overlapping through rounding
+#define SKIN 0.01f
+
+typedef struct Hit {
+    float t; // fraction of the motion
+    Vector2 normal;
+} Hit;
+
+void colliderReset(Collider *c, const struct Level *level, uint32_t seed)
+{
+    *c = (Collider){
+        .level = level,
+        .seed = seed,
+    };
+}
+
+// the chunk index, generated into the least recently used slot when missing
+static const Chunk *colliderChunk(Collider *c, int index)
+{
+    Chunk *slot = &c->chunks[0];
+    for (int i = 0; i < COLLIDE_MAX_CHUNKS; i += 1) {
+        Chunk *ch = &c->chunks[i];
+        if (ch->resident && ch->index == index) {
+            ch->lastUsed = c->frame;
+            return ch;
+        }
+        if (slot->resident &&
+            (!ch->resident || ch->lastUsed < slot->lastUsed)) {
+            slot = ch;
+        }
+    }
+
+    chunkGenerate(slot, c->level, c->seed, index);
+    slot->lastUsed = c->frame;
+    return slot;
+}
+
+static Rectangle sweptBounds(Vector2 p, Vector2 motion, float radius)
+{
+    Vector2 min = Vector2Min(p, Vector2Add(p, motion));
+    Vector2 max = Vector2Max(p, Vector2Add(p, motion));
+    return (Rectangle){
+        min.x - radius,
+        min.y - radius,
+        max.x - min.x + 2 * radius,
+        max.y - min.y + 2 * radius,
+    };
+}
+
+// first t in [0, 1] where p + t * d is radius away from center
+static bool sweepPoint(Vector2 p, Vector2 d, Vector2 center, float radius,
+                       float *t)
+{
+    Vector2 m = Vector2Subtract(p, center);
+    float a = Vector2DotProduct(d, d);
+    float b = Vector2DotProduct(m, d);
+    float c = Vector2DotProduct(m, m) - radius * radius;
+    if (b >= 0 || a == 0) {
+        // moving away
+        return false;
+    }
+    if (c <= 0) {
+        // already touching
+        *t = 0;
+        return true;
+    }
+
+    float disc = b * b - a * c;
+    if (disc < 0) {
+        return false;
+    }
+    *t = (-b - sqrtf(disc)) / a;
+    return *t <= 1;
+}
+
+// p + t * d against rect grown by radius with rounded corners
+static bool sweepRect(Vector2 p, Vector2 d, float radius, Rectangle rect,
+                      Hit *hit)
+{
+    const float min[2] = {rect.x - radius, rect.y - radius};
+    const float max[2] = {rect.x + rect.width + radius,
+                          rect.y + rect.height + radius};
+    const float from[2] = {p.x, p.y};
+    const float dir[2] = {d.x, d.y};
+
+    float enter = -FLT_MAX;
+    float exit = FLT_MAX;
+    Vector2 normal = {0};
+    for (int axis = 0; axis < 2; axis += 1) {
+        if (dir[axis] == 0) {
+            if (from[axis] < min[axis] || from[axis] > max[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        float t0 = (min[axis] - from[axis]) / dir[axis];
+        float t1 = (max[axis] - from[axis]) / dir[axis];
+        float side = -1;
+        if (t0 > t1) {
+            float swap = t0;
+            t0 = t1;
+            t1 = swap;
+            side = 1;
+        }
+        if (t0 > enter) {
+            enter = t0;
+            normal = axis == 0 ? (Vector2){side, 0} : (Vector2){0, side};
+        }
+        exit = fminf(exit, t1);
+    }
+
+    if (enter > exit || enter > 1 || exit < 0) {
+        return false;
+    }
+    // starting on the surface, rounding puts the circle just inside after a
+    // slide, only counts when moving further in
+    if (enter < 0) {
+        if (Vector2DotProduct(d, normal) >= 0) {
+            return false;
+        }
+        enter = 0;
+    }
+
+    // corners of the grown rectangle are rounded
+    Vector2 q = Vector2Add(p, Vector2Scale(d, enter));
+    bool left = q.x < rect.x;
+    bool right = q.x > rect.x + rect.width;
+    bool above = q.y < rect.y;
+    bool below = q.y > rect.y + rect.height;
+    if ((left || right) && (above || below)) {
+        Vector2 corner = {
+            left ? rect.x : rect.x + rect.width,
+            above ? rect.y : rect.y + rect.height,
+        };
+        if (!sweepPoint(p, d, corner, radius, &enter)) {
+            return false;
+        }
+        q = Vector2Add(p, Vector2Scale(d, enter));
+        normal = Vector2Normalize(Vector2Subtract(q, corner));
+        if (Vector2DotProduct(d, normal) >= 0) {
+            return false;
+        }
+    }
+
+    hit->t = enter;
+    hit->normal = normal;
+    return true;
+}
+
+// earliest hit of the move against the ground and the nearby buildings
+static bool sweep(Collider *c, Vector2 p, Vector2 d, float radius, Hit *hit)
+{
+    bool found = false;
+    hit->t = FLT_MAX;
+
+    float floor = GROUND_Y - radius;
+    if (d.y > 0 && p.y <= floor && p.y + d.y > floor) {
+        hit->t = (floor - p.y) / d.y;
+        hit->normal = (Vector2){0, -1};
+        found = true;
+    }
+
+    Rectangle bounds = sweptBounds(p, d, radius);
+    int last = chunkIndexAt(bounds.x + bounds.width);
+    for (int i = chunkIndexAt(bounds.x); i <= last; i += 1) {
+        const Chunk *ch = colliderChunk(c, i);
+        SpatialRange near = spatialIndexQuery(&ch->spatial, bounds);
+        c->candidates += near.count;
+
+        for (int j = 0; j < near.count; j += 1) {
+            Hit h;
+            Rectangle rect = ch->buildings[near.first + j].rect;
+            if (sweepRect(p, d, radius, rect, &h) && h.t < hit->t) {
+                *hit = h;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+static void removeInto(Vector2 *v, Vector2 normal)
+{
+    float into = Vector2DotProduct(*v, normal);
+    if (into < 0) {
+        *v = Vector2Subtract(*v, Vector2Scale(normal, into));
+    }
+}
+
+// Move a circle that overlaps rect out of it the shortest way
+static bool pushOutRect(Vector2 *p, float radius, Rectangle rect,
+                        Vector2 *normal)
+{
+    Vector2 closest = {
+        Clamp(p->x, rect.x, rect.x + rect.width),
+        Clamp(p->y, rect.y, rect.y + rect.height),
+    };
+    Vector2 delta = Vector2Subtract(*p, closest);
+    float dist = Vector2Length(delta);
+    if (dist >= radius) {
+        return false;
+    }
+
+    if (dist > 0) {
+        *normal = Vector2Scale(delta, 1 / dist);
+        *p = Vector2Add(closest, Vector2Scale(*normal, radius + SKIN));
+        return true;
+    }
+
+    // the center is inside, leave through the nearest side
+    float sides[4] = {
+        p->x - rect.x,
+        rect.x + rect.width - p->x,
+        p->y - rect.y,
+        rect.y + rect.height - p->y,
+    };
+    const Vector2 normals[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int nearest = 0;
+    for (int i = 1; i < 4; i += 1) {
+        if (sides[i] < sides[nearest]) {
+            nearest = i;
+        }
+    }
+    *normal = normals[nearest];
+    *p = Vector2Add(*p,
+                    Vector2Scale(*normal, sides[nearest] + radius + SKIN));
+    return true;
+}
+
+// Something put the circle inside the world, e.g. a teleport or a new level
+static Vector2 pushOut(Collider *c, Vector2 p, float radius, Vector2 *vel)
+{
+    float floor = GROUND_Y - radius;
+    if (p.y > floor) {
+        p.y = floor - SKIN;
+        removeInto(vel, (Vector2){0, -1});
+    }
+
+    Rectangle bounds = sweptBounds(p, Vector2Zero(), radius);
+    int last = chunkIndexAt(bounds.x + bounds.width);
+    for (int i = chunkIndexAt(bounds.x); i <= last; i += 1) {
+        const Chunk *ch = colliderChunk(c, i);
+        SpatialRange near = spatialIndexQuery(&ch->spatial, bounds);
+        c->candidates += near.count;
+
+        for (int j = 0; j < near.count; j += 1) {
+            Vector2 normal;
+            Rectangle rect = ch->buildings[near.first + j].rect;
+            if (pushOutRect(&p, radius, rect, &normal)) {
+                removeInto(vel, normal);
+            }
+        }
+    }
+    return p;
+}
+
+Vector2 collideMove(Collider *c, Vector2 from, Vector2 motion, float radius,
+                    Vector2 *vel)
+{
+    c->frame += 1;
+    c->candidates = 0;
+
+    Vector2 p = pushOut(c, from, radius, vel);
+
+    for (int i = 0; i < MAX_SLIDES; i += 1) {
+        float len = Vector2Length(motion);
+        if (len == 0) {
+            break;
+        }
+
+        Hit hit;
+        if (!sweep(c, p, motion, radius, &hit)) {
+            p = Vector2Add(p, motion);
+            break;
+        }
+
+        // stop just short of the surface and slide along it with what is
+        // left of the motion
+        float t = fmaxf(0, hit.t - SKIN / len);
+        p = Vector2Add(p, Vector2Scale(motion, t));
+
+        Vector2 rest = Vector2Scale(motion, 1 - t);
+        float into = Vector2DotProduct(rest, hit.normal);
+        motion = Vector2Subtract(rest, Vector2Scale(hit.normal, into));
+        removeInto(vel, hit.normal);
+    }
+    return p;
+}
@@ -0,0 +1,41 @@
+#ifndef COLLIDE_H
+#define COLLIDE_H
+
+#include <raylib.h>
+#include <stdint.h>
+
+#include "world.h"
+
+// Circle movement against the buildings and the ground
+//
+// The simulation keeps its own few chunks instead of sharing the render
+// thread's pool. A chunk that is not there is generated on the spot, so
+// collisions never depend on what happened to be streamed in and replays
+// stay exact.
+//
+// The broadphase takes the chunks under the swept bounds of the move and
+// queries their spatial indices, the narrowphase sweeps the circle against
+// each candidate as a ray against the rectangle grown by the radius with
+// rounded corners. Moves slide along what they hit.
+
+#define COLLIDE_MAX_CHUNKS 4
+
+typedef struct Collider {
+    const struct Level *level;
+    uint32_t seed;
+    Chunk chunks[COLLIDE_MAX_CHUNKS];
+    unsigned int frame;
+
+    // stats for the last move
+    int candidates;
+} Collider;
+
+// forget all chunks, call whenever the world's seed or level changes
+void colliderReset(Collider *c, const struct Level *level, uint32_t seed);
+
+// move a circle at from by motion, returns where it ends up and takes the
+// part of vel going into whatever it touched away
+Vector2 collideMove(Collider *c, Vector2 from, Vector2 motion, float radius,
+                    Vector2 *vel);
+
+#endif
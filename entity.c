@@ -0,0 +1,192 @@
+#include "entity.h"
+#include "entitysimd.h"
+
+#include <assert.h>
+#include <math.h>
+#include <raymath.h>
+#include <string.h>
+
+#include "alloc.h"
+
+Vector2 Vector2Polate(Vector2 curr, Vector2 dest, float t)
+{
+    // float only, the SIMD kernels repeat exactly these operations
+    float dx = dest.x - curr.x;
+    float dy = dest.y - curr.y;
+    return (Vector2){
+        .x = curr.x + dx * 0.5f * t * t + dx * t,
+        .y = curr.y + dy * 0.5f * t * t + dy * t,
+    };
+}
+
+void entityStoreInit(EntityStore *s, size_t capacity)
+{
+    *s = (EntityStore){
+        .pos = allocMem(ALLOC_ENTITIES, capacity * sizeof(*s->pos)),
+        .prevPos = allocMem(ALLOC_ENTITIES, capacity * sizeof(*s->prevPos)),
+        .vel = allocMem(ALLOC_ENTITIES, capacity * sizeof(*s->vel)),
+        .targetVel = allocMem(ALLOC_ENTITIES, capacity * sizeof(*s->targetVel)),
+        .velTransitionTime =
+            allocMem(ALLOC_ENTITIES, capacity * sizeof(*s->velTransitionTime)),
+        .maxVel = allocMem(ALLOC_ENTITIES, capacity * sizeof(*s->maxVel)),
+        .radius = allocMem(ALLOC_ENTITIES, capacity * sizeof(*s->radius)),
+        .capacity = capacity,
+    };
+}
+
+void entityStoreFree(EntityStore *s)
+{
+    allocFree(s->pos);
+    allocFree(s->prevPos);
+    allocFree(s->vel);
+    allocFree(s->targetVel);
+    allocFree(s->velTransitionTime);
+    allocFree(s->maxVel);
+    allocFree(s->radius);
+
+    *s = (EntityStore){0};
+}
+
+void entityStoreClear(EntityStore *s) { s->len = 0; }
+
+size_t entityAdd(EntityStore *s, Player p)
+{
+    assert(s->len < s->capacity);
+
+    size_t i = s->len;
+    s->pos[i] = p.pos;
+    if (s->prevPos != NULL) {
+        s->prevPos[i] = p.pos;
+    }
+    s->vel[i] = p.vel;
+    s->targetVel[i] = p.targetVel;
+    s->velTransitionTime[i] = p.velTransitionTime;
+    s->maxVel[i] = p.maxVel;
+    s->radius[i] = p.radius;
+
+    s->len += 1;
+    return i;
+}
+
+uint32_t entityStoreHash(const EntityStore *s)
+{
+    // FNV-1a over the simulated state
+    uint32_t h = 2166136261u;
+    const struct {
+        const void *data;
+        size_t size;
+    } arrays[] = {
+        {s->pos, s->len * sizeof(*s->pos)},
+        {s->vel, s->len * sizeof(*s->vel)},
+        {s->velTransitionTime, s->len * sizeof(*s->velTransitionTime)},
+    };
+
+    for (size_t a = 0; a < sizeof(arrays) / sizeof(*arrays); a += 1) {
+        const unsigned char *bytes = arrays[a].data;
+        for (size_t i = 0; i < arrays[a].size; i += 1) {
+            h = (h ^ bytes[i]) * 16777619u;
+        }
+    }
+    return h;
+}
+
+Player entityGet(const EntityStore *s, size_t i)
+{
+    return (Player){
+        .pos = s->pos[i],
+        .vel = s->vel[i],
+        .targetVel = s->targetVel[i],
+        .maxVel = s->maxVel[i],
+        .radius = s->radius[i],
+        .velTransitionTime = s->velTransitionTime[i],
+    };
+}
+
+Vector2 entityLerpPos(const EntityStore *s, size_t i, float t)
+{
+    if (s->prevPos == NULL) {
+        return s->pos[i];
+    }
+    return Vector2Lerp(s->prevPos[i], s->pos[i], t);
+}
+
+void playersUpdateRange(EntityStore *s, size_t first, size_t count)
+{
+    assert(first + count <= s->len);
+
+    if (s->prevPos != NULL) {
+        memcpy(&s->prevPos[first], &s->pos[first], count * sizeof(*s->pos));
+    }
+
+    {
+        // positions and velocities are contiguous floats, x and y get the
+        // same treatment so this is one flat loop the compiler can vectorize
+        float *restrict pos = (float *)&s->pos[first];
+        const float *restrict vel = (const float *)&s->vel[first];
+        for (size_t i = 0; i < count * 2; i += 1) {
+            pos[i] += vel[i] * SIM_STEP_SCALE;
+        }
+    }
+
+    // 0.9 per 60Hz frame
+    const float damping = powf(0.9f, SIM_STEP_SCALE);
+    velocityUpdate(&s->vel[first], &s->targetVel[first],
+                   &s->velTransitionTime[first], count, damping);
+}
+
+void playersUpdate(EntityStore *s, size_t count)
+{
+    playersUpdateRange(s, 0, count);
+}
+
+bool playersStop(EntityStore *s, size_t i)
+{
+    if (s->velTransitionTime[i] == 0) {
+        s->velTransitionTime[i] = -1;
+    }
+    return s->velTransitionTime[i] < 0;
+}
+
+void playersMove(EntityStore *s, size_t i, Vector2 direction)
+{
+    s->velTransitionTime[i] = PLAYER_VEL_TRANSITION_FRAMES;
+
+    if (s->maxVel[i] / Vector2Length(direction) < 1.0) {
+        direction = Vector2Scale(Vector2Normalize(direction), s->maxVel[i]);
+    }
+
+    s->targetVel[i] = direction;
+}
+
+// one entity store over the fields of a Player
+static EntityStore playerView(Player *p)
+{
+    return (EntityStore){
+        .pos = &p->pos,
+        .vel = &p->vel,
+        .targetVel = &p->targetVel,
+        .velTransitionTime = &p->velTransitionTime,
+        .maxVel = &p->maxVel,
+        .radius = &p->radius,
+        .len = 1,
+        .capacity = 1,
+    };
+}
+
+void playerUpdate(Player *p)
+{
+    EntityStore s = playerView(p);
+    playersUpdate(&s, 1);
+}
+
+void playerMove(Player *p, Vector2 direction)
+{
+    EntityStore s = playerView(p);
+    playersMove(&s, 0, direction);
+}
+
+bool playerStop(Player *p)
+{
+    EntityStore s = playerView(p);
+    return playersStop(&s, 0);
+}
@@ -0,0 +1,74 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The simulation runs at a fixed rate that is independent of the render rate.
+// Movement was tuned for one update per 60Hz frame, so per step quantities are
+// scaled by SIM_STEP_SCALE to keep the same feel at SIM_HZ.
+#define SIM_HZ 120
+#define SIM_STEP_SCALE (60.0f / SIM_HZ)
+
+// counted in simulation steps
+#define PLAYER_VEL_TRANSITION_FRAMES (30 * SIM_HZ / 60)
+
+typedef struct Player {
+    Vector2 pos;
+    Vector2 vel;
+    Vector2 targetVel;
+
+    float maxVel;
+    float radius;
+    int velTransitionTime;
+} Player;
+
+// Structure of arrays storage for everything that moves like a Player, entity
+// i is made of element i of every array.
+//
+// prevPos is the position before the last playersUpdate(), used to interpolate
+// rendering between simulation steps, it may be NULL when nobody needs it.
+typedef struct EntityStore {
+    Vector2 *pos;
+    Vector2 *prevPos;
+    Vector2 *vel;
+    Vector2 *targetVel;
+    int *velTransitionTime;
+    float *maxVel;
+    float *radius;
+
+    size_t len;
+    size_t capacity;
+} EntityStore;
+
+Vector2 Vector2Polate(Vector2 curr, Vector2 dest, float t);
+
+void entityStoreInit(EntityStore *s, size_t capacity);
+void entityStoreFree(EntityStore *s);
+void entityStoreClear(EntityStore *s);
+
+// returns the new entity's index, the store must not be full
+size_t entityAdd(EntityStore *s, Player p);
+Player entityGet(const EntityStore *s, size_t i);
+// hash of the simulated state, equal hashes mean identical simulations
+uint32_t entityStoreHash(const EntityStore *s);
+// interpolated position between the last two steps, t in [0, 1]
+Vector2 entityLerpPos(const EntityStore *s, size_t i, float t);
+
+// Advance entities [0, count) by one simulation step
+void playersUpdate(EntityStore *s, size_t count);
+// same for [first, first + count), disjoint ranges can run concurrently
+void playersUpdateRange(EntityStore *s, size_t first, size_t count);
+void playersMove(EntityStore *s, size_t i, Vector2 direction);
+// starts slowing down once the velocity reached its target, false while it
+// is still transitioning and the stop has to be retried later
+bool playersStop(EntityStore *s, size_t i);
+
+// A single Player goes through the same code as a one entity store
+void playerUpdate(Player *p);
+void playerMove(Player *p, Vector2 direction);
+bool playerStop(Player *p);
+
+#endif
@@ -0,0 +1,213 @@
+#include "entitybatch.h"
+
+#include <raymath.h>
+#include <rlgl.h>
+
+#define VERTICES_PER_QUAD 6
+
+// mode 0 draws the circle of an entity, 1 its velocity arrow, both from the
+// same unit quad
+static const char *VERTEX_SHADER =
+    "#version 330\n"
+    "in vec2 vertexPosition;\n"
+    "in vec2 instancePos;\n"
+    "in vec2 instancePrevPos;\n"
+    "in vec2 instanceVel;\n"
+    "in float instanceRadius;\n"
+    "in vec4 instanceColor;\n"
+    "uniform mat4 mvp;\n"
+    "uniform float alpha;\n"
+    "uniform int mode;\n"
+    "uniform vec2 arrow;\n" // length, width
+    "uniform vec4 arrowColor;\n"
+    "out vec2 fragCorner;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 center = mix(instancePrevPos, instancePos, alpha);\n"
+    "    vec2 world;\n"
+    "    if (mode == 0) {\n"
+    "        world = center + vertexPosition * instanceRadius;\n"
+    "        fragColor = instanceColor;\n"
+    "    } else {\n"
+    "        float speed = length(instanceVel);\n"
+    "        vec2 dir = speed > 0.0 ? instanceVel / speed : vec2(0.0);\n"
+    "        vec2 side = vec2(-dir.y, dir.x);\n"
+    "        float along = (vertexPosition.x + 1.0) * 0.5 * arrow.x;\n"
+    "        float across = vertexPosition.y * 0.5 * arrow.y;\n"
+    "        world = center + dir * along + side * across;\n"
+    "        fragColor = arrowColor;\n"
+    "    }\n"
+    "    fragCorner = vertexPosition;\n"
+    "    gl_Position = mvp * vec4(world, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *FRAGMENT_SHADER =
+    "#version 330\n"
+    "in vec2 fragCorner;\n"
+    "in vec4 fragColor;\n"
+    "uniform int mode;\n"
+    "out vec4 finalColor;\n"
+    "void main()\n"
+    "{\n"
+    "    if (mode == 0 && dot(fragCorner, fragCorner) > 1.0) {\n"
+    "        discard;\n"
+    "    }\n"
+    "    finalColor = fragColor;\n"
+    "}\n";
+
+// same winding as DrawRectangleRec so backface culling keeps it
+static const float QUAD[VERTICES_PER_QUAD * 2] = {
+    -1, -1, -1, 1, 1, 1, -1, -1, 1, 1, 1, -1,
+};
+
+// a per instance attribute in its own buffer, false when the shader does not
+// have it
+static bool instanceAttribute(const EntityBatch *b, const char *name,
+                              unsigned int *vbo, int size, int components,
+                              int type, bool normalized)
+{
+    int loc = GetShaderLocationAttrib(b->shader, name);
+    if (loc < 0) {
+        return false;
+    }
+    *vbo = rlLoadVertexBuffer(NULL, (int)b->capacity * size, true);
+    rlSetVertexAttribute(loc, components, type, normalized, 0, 0);
+    rlSetVertexAttributeDivisor(loc, 1);
+    rlEnableVertexAttribute(loc);
+    return true;
+}
+
+bool entityBatchInit(EntityBatch *b, size_t capacity)
+{
+    *b = (EntityBatch){
+        .shader = LoadShaderFromMemory(VERTEX_SHADER, FRAGMENT_SHADER),
+        .capacity = capacity,
+    };
+    // raylib hands out the default shader when compiling fails
+    if (b->shader.id == 0 || b->shader.id == rlGetShaderIdDefault()) {
+        *b = (EntityBatch){0};
+        return false;
+    }
+    b->mvpLoc = GetShaderLocation(b->shader, "mvp");
+    b->alphaLoc = GetShaderLocation(b->shader, "alpha");
+    b->modeLoc = GetShaderLocation(b->shader, "mode");
+    b->arrowLoc = GetShaderLocation(b->shader, "arrow");
+    b->colorLoc = GetShaderLocation(b->shader, "arrowColor");
+
+    b->vao = rlLoadVertexArray();
+    rlEnableVertexArray(b->vao);
+
+    b->quadVbo = rlLoadVertexBuffer(QUAD, sizeof(QUAD), false);
+    int quadLoc = GetShaderLocationAttrib(b->shader, "vertexPosition");
+    rlSetVertexAttribute(quadLoc, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(quadLoc);
+
+    bool ok = quadLoc >= 0;
+    ok = ok && instanceAttribute(b, "instancePos", &b->posVbo,
+                                 sizeof(Vector2), 2, RL_FLOAT, false);
+    ok = ok && instanceAttribute(b, "instancePrevPos", &b->prevPosVbo,
+                                 sizeof(Vector2), 2, RL_FLOAT, false);
+    ok = ok && instanceAttribute(b, "instanceVel", &b->velVbo,
+                                 sizeof(Vector2), 2, RL_FLOAT, false);
+    ok = ok && instanceAttribute(b, "instanceRadius", &b->radiusVbo,
+                                 sizeof(float), 1, RL_FLOAT, false);
+    ok = ok && instanceAttribute(b, "instanceColor", &b->colorVbo,
+                                 sizeof(Color), 4, RL_UNSIGNED_BYTE, true);
+    rlDisableVertexArray();
+
+    if (!ok) {
+        entityBatchUnload(b);
+        return false;
+    }
+    return true;
+}
+
+void entityBatchUnload(EntityBatch *b)
+{
+    if (b->vao != 0) {
+        rlUnloadVertexArray(b->vao);
+    }
+    const unsigned int vbos[] = {b->quadVbo,   b->posVbo,    b->prevPosVbo,
+                                 b->velVbo,    b->radiusVbo, b->colorVbo};
+    for (size_t i = 0; i < sizeof(vbos) / sizeof(*vbos); i += 1) {
+        if (vbos[i] != 0) {
+            rlUnloadVertexBuffer(vbos[i]);
+        }
+    }
+    if (b->shader.id != 0) {
+        UnloadShader(b->shader);
+    }
+
+    *b = (EntityBatch){0};
+}
+
+static void batchBegin(const EntityBatch *b, int mode)
+{
+    // flush what was drawn before us so the draw order is kept
+    rlDrawRenderBatchActive();
+
+    Matrix mvp =
+        MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+    rlEnableShader(b->shader.id);
+    rlSetUniformMatrix(b->mvpLoc, mvp);
+    rlSetUniform(b->modeLoc, &mode, SHADER_UNIFORM_INT, 1);
+    rlEnableVertexArray(b->vao);
+}
+
+static void batchEnd(const EntityBatch *b)
+{
+    rlDrawVertexArrayInstanced(0, VERTICES_PER_QUAD, (int)b->len);
+    rlDisableVertexArray();
+    rlDisableShader();
+}
+
+void entityBatchDraw(EntityBatch *b, const EntityView *v)
+{
+    size_t len = v->len < b->capacity ? v->len : b->capacity;
+    b->len = len;
+    if (len == 0) {
+        return;
+    }
+
+    // straight from the arrays, whatever layout they have in memory is
+    // already what the attributes expect
+    rlUpdateVertexBuffer(b->posVbo, v->pos, (int)(len * sizeof(*v->pos)), 0);
+    rlUpdateVertexBuffer(b->prevPosVbo, v->prevPos,
+                         (int)(len * sizeof(*v->prevPos)), 0);
+    rlUpdateVertexBuffer(b->velVbo, v->vel, (int)(len * sizeof(*v->vel)), 0);
+    rlUpdateVertexBuffer(b->radiusVbo, v->radius,
+                         (int)(len * sizeof(*v->radius)), 0);
+    rlUpdateVertexBuffer(b->colorVbo, v->color,
+                         (int)(len * sizeof(*v->color)), 0);
+
+    b->alpha = v->alpha;
+    entityBatchRedraw(b);
+}
+
+void entityBatchRedraw(const EntityBatch *b)
+{
+    if (b->len == 0) {
+        return;
+    }
+
+    batchBegin(b, 0);
+    rlSetUniform(b->alphaLoc, &b->alpha, SHADER_UNIFORM_FLOAT, 1);
+    batchEnd(b);
+}
+
+void entityBatchDrawArrows(const EntityBatch *b, float length, float width,
+                           Color color)
+{
+    if (b->len == 0) {
+        return;
+    }
+
+    const float arrow[2] = {length, width};
+    const float tint[4] = {color.r / 255.0f, color.g / 255.0f,
+                           color.b / 255.0f, color.a / 255.0f};
+    batchBegin(b, 1);
+    rlSetUniform(b->arrowLoc, arrow, SHADER_UNIFORM_VEC2, 1);
+    rlSetUniform(b->colorLoc, tint, SHADER_UNIFORM_VEC4, 1);
+    batchEnd(b);
+}
@@ -0,0 +1,64 @@
+#ifndef ENTITYBATCH_H
+#define ENTITYBATCH_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Instanced drawing of entities and their velocity arrows
+//
+// Every array of an EntityView goes as is into its own vertex buffer, one
+// instance per entity, and the vertex shader interpolates the position and
+// expands a unit quad into the entity's circle or into an arrow along its
+// velocity. All circles are a single draw call and all arrows another, the
+// CPU does not touch the entities one by one.
+//
+// Needs GLSL 330 and instancing, entityBatchInit() fails without them and
+// the caller keeps drawing with DrawCircleV().
+
+// structure of arrays of what is drawn, the arrays are only read
+typedef struct EntityView {
+    const Vector2 *pos;
+    const Vector2 *prevPos;
+    const Vector2 *vel;
+    const float *radius;
+    const Color *color;
+    size_t len;
+    float alpha; // position is prevPos + (pos - prevPos) * alpha
+} EntityView;
+
+typedef struct EntityBatch {
+    Shader shader;
+    int mvpLoc;
+    int alphaLoc;
+    int modeLoc;
+    int arrowLoc;
+    int colorLoc;
+
+    unsigned int vao;
+    unsigned int quadVbo;
+    unsigned int posVbo;
+    unsigned int prevPosVbo;
+    unsigned int velVbo;
+    unsigned int radiusVbo;
+    unsigned int colorVbo;
+    size_t capacity;
+    size_t len; // instances uploaded by the last entityBatchDraw()
+    float alpha;
+} EntityBatch;
+
+bool entityBatchInit(EntityBatch *b, size_t capacity);
+void entityBatchUnload(EntityBatch *b);
+
+// Draw the circles of v under the current 2D transform, v->len must be at
+// most the capacity
+void entityBatchDraw(EntityBatch *b, const EntityView *v);
+// the circles of the last entityBatchDraw() again, for another view, without
+// uploading them again
+void entityBatchRedraw(const EntityBatch *b);
+// Velocity arrows of length and width world units for the entities of the
+// last entityBatchDraw(), without uploading them again
+void entityBatchDrawArrows(const EntityBatch *b, float length, float width,
+                           Color color);
+
+#endif
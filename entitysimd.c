@@ -0,0 +1,293 @@
+#include "entitysimd.h"
+
+#include <string.h>
+
+#include "entity.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
+typedef void (*VelocityFn)(Vector2 *restrict vel,
+                           const Vector2 *restrict targetVel,
+                           int *restrict velTransitionTime, size_t count,
+                           float damping);
+
+static const float FRAMES = (float)PLAYER_VEL_TRANSITION_FRAMES;
+
+// Reference implementation, the SIMD versions use it for the remainder
+static void velocityScalar(Vector2 *restrict vel,
+                           const Vector2 *restrict targetVel,
+                           int *restrict velTransitionTime, size_t count,
+                           float damping)
+{
+    for (size_t i = 0; i < count; i += 1) {
+        int time = velTransitionTime[i];
+
+        if (time > 0) {
+            vel[i] =
+                Vector2Polate(vel[i], targetVel[i], 1 - ((float)time / FRAMES));
+            velTransitionTime[i] = time - 1;
+        } else if (time == -1) {
+            vel[i].x = vel[i].x * damping;
+            vel[i].y = vel[i].y * damping;
+        }
+    }
+}
+
+#ifdef HAVE_X86
+// vel and targetVel hold x, y pairs so each entity takes two lanes, its time
+// is duplicated into both of them
+static inline __m128 polateSse(__m128 v, __m128 d, __m128i time)
+{
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    __m128 t = _mm_sub_ps(one, _mm_div_ps(_mm_cvtepi32_ps(time),
+                                          _mm_set1_ps(FRAMES)));
+    __m128 dx = _mm_sub_ps(d, v);
+    __m128 curve = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(dx, half), t), t);
+    return _mm_add_ps(_mm_add_ps(v, curve), _mm_mul_ps(dx, t));
+}
+
+static inline __m128 stepSse(__m128 v, __m128 d, __m128i time,
+                             __m128 damping)
+{
+    __m128 moving = _mm_castsi128_ps(_mm_cmpgt_epi32(time, _mm_setzero_si128()));
+    __m128 stopped =
+        _mm_castsi128_ps(_mm_cmpeq_epi32(time, _mm_set1_epi32(-1)));
+
+    __m128 out = _mm_andnot_ps(_mm_or_ps(moving, stopped), v);
+    out = _mm_or_ps(out, _mm_and_ps(moving, polateSse(v, d, time)));
+    out = _mm_or_ps(out, _mm_and_ps(stopped, _mm_mul_ps(v, damping)));
+    return out;
+}
+
+static void velocitySse2(Vector2 *restrict vel,
+                         const Vector2 *restrict targetVel,
+                         int *restrict velTransitionTime, size_t count,
+                         float damping)
+{
+    const __m128 damp = _mm_set1_ps(damping);
+    float *v = (float *)vel;
+    const float *d = (const float *)targetVel;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i time = _mm_loadu_si128((const __m128i *)&velTransitionTime[i]);
+
+        __m128 lo = stepSse(_mm_loadu_ps(&v[i * 2]), _mm_loadu_ps(&d[i * 2]),
+                            _mm_unpacklo_epi32(time, time), damp);
+        __m128 hi =
+            stepSse(_mm_loadu_ps(&v[i * 2 + 4]), _mm_loadu_ps(&d[i * 2 + 4]),
+                    _mm_unpackhi_epi32(time, time), damp);
+        _mm_storeu_ps(&v[i * 2], lo);
+        _mm_storeu_ps(&v[i * 2 + 4], hi);
+
+        // the compare mask is -1 where time > 0
+        time = _mm_add_epi32(time, _mm_cmpgt_epi32(time, _mm_setzero_si128()));
+        _mm_storeu_si128((__m128i *)&velTransitionTime[i], time);
+    }
+
+    velocityScalar(&vel[i], &targetVel[i], &velTransitionTime[i], count - i,
+                   damping);
+}
+
+__attribute__((target("avx2"))) static void
+velocityAvx2(Vector2 *restrict vel, const Vector2 *restrict targetVel,
+             int *restrict velTransitionTime, size_t count, float damping)
+{
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 frames = _mm256_set1_ps(FRAMES);
+    const __m256 damp = _mm256_set1_ps(damping);
+    const __m256i pairs = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    float *vp = (float *)vel;
+    const float *dp = (const float *)targetVel;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i time4 =
+            _mm_loadu_si128((const __m128i *)&velTransitionTime[i]);
+        __m256i time =
+            _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(time4), pairs);
+
+        __m256 v = _mm256_loadu_ps(&vp[i * 2]);
+        __m256 d = _mm256_loadu_ps(&dp[i * 2]);
+
+        __m256 t =
+            _mm256_sub_ps(one, _mm256_div_ps(_mm256_cvtepi32_ps(time), frames));
+        __m256 dx = _mm256_sub_ps(d, v);
+        __m256 curve =
+            _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(dx, half), t), t);
+        __m256 polated =
+            _mm256_add_ps(_mm256_add_ps(v, curve), _mm256_mul_ps(dx, t));
+
+        __m256 moving = _mm256_castsi256_ps(
+            _mm256_cmpgt_epi32(time, _mm256_setzero_si256()));
+        __m256 stopped = _mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(time, _mm256_set1_epi32(-1)));
+
+        __m256 out = _mm256_blendv_ps(v, polated, moving);
+        out = _mm256_blendv_ps(out, _mm256_mul_ps(v, damp), stopped);
+        _mm256_storeu_ps(&vp[i * 2], out);
+
+        time4 = _mm_add_epi32(time4, _mm_cmpgt_epi32(time4, _mm_setzero_si128()));
+        _mm_storeu_si128((__m128i *)&velTransitionTime[i], time4);
+    }
+
+    velocityScalar(&vel[i], &targetVel[i], &velTransitionTime[i], count - i,
+                   damping);
+}
+#endif
+
+#ifdef HAVE_NEON
+static inline float32x4_t stepNeon(float32x4_t v, float32x4_t d,
+                                   int32x4_t time, float32x4_t damping)
+{
+    float32x4_t t = vsubq_f32(
+        vdupq_n_f32(1), vdivq_f32(vcvtq_f32_s32(time), vdupq_n_f32(FRAMES)));
+    float32x4_t dx = vsubq_f32(d, v);
+    float32x4_t curve =
+        vmulq_f32(vmulq_f32(vmulq_f32(dx, vdupq_n_f32(0.5f)), t), t);
+    float32x4_t polated = vaddq_f32(vaddq_f32(v, curve), vmulq_f32(dx, t));
+
+    uint32x4_t moving = vcgtq_s32(time, vdupq_n_s32(0));
+    uint32x4_t stopped = vceqq_s32(time, vdupq_n_s32(-1));
+
+    float32x4_t out = vbslq_f32(moving, polated, v);
+    return vbslq_f32(stopped, vmulq_f32(v, damping), out);
+}
+
+static void velocityNeon(Vector2 *restrict vel,
+                         const Vector2 *restrict targetVel,
+                         int *restrict velTransitionTime, size_t count,
+                         float damping)
+{
+    const float32x4_t damp = vdupq_n_f32(damping);
+    float *v = (float *)vel;
+    const float *d = (const float *)targetVel;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32x4_t time = vld1q_s32(&velTransitionTime[i]);
+
+        float32x4_t lo = stepNeon(vld1q_f32(&v[i * 2]), vld1q_f32(&d[i * 2]),
+                                  vzip1q_s32(time, time), damp);
+        float32x4_t hi =
+            stepNeon(vld1q_f32(&v[i * 2 + 4]), vld1q_f32(&d[i * 2 + 4]),
+                     vzip2q_s32(time, time), damp);
+        vst1q_f32(&v[i * 2], lo);
+        vst1q_f32(&v[i * 2 + 4], hi);
+
+        // the compare mask is -1 where time > 0
+        time = vaddq_s32(time,
+                         vreinterpretq_s32_u32(vcgtq_s32(time, vdupq_n_s32(0))));
+        vst1q_s32(&velTransitionTime[i], time);
+    }
+
+    velocityScalar(&vel[i], &targetVel[i], &velTransitionTime[i], count - i,
+                   damping);
+}
+#endif
+
+static VelocityKernel chosen = VELOCITY_KERNEL_AUTO;
+
+static bool kernelAvailable(VelocityKernel k)
+{
+    switch (k) {
+    case VELOCITY_KERNEL_AUTO:
+    case VELOCITY_KERNEL_SCALAR:
+        return true;
+#ifdef HAVE_X86
+    case VELOCITY_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case VELOCITY_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef HAVE_NEON
+    case VELOCITY_KERNEL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+static VelocityKernel kernelResolve()
+{
+    if (chosen != VELOCITY_KERNEL_AUTO) {
+        return chosen;
+    }
+
+    const VelocityKernel preferred[] = {
+        VELOCITY_KERNEL_AVX2,
+        VELOCITY_KERNEL_NEON,
+        VELOCITY_KERNEL_SSE2,
+    };
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(*preferred); i += 1) {
+        if (kernelAvailable(preferred[i])) {
+            return preferred[i];
+        }
+    }
+    return VELOCITY_KERNEL_SCALAR;
+}
+
+bool velocityKernelSet(VelocityKernel k)
+{
+    if (!kernelAvailable(k)) {
+        return false;
+    }
+    chosen = k;
+    return true;
+}
+
+static const char *KERNEL_NAMES[] = {
+    [VELOCITY_KERNEL_AUTO] = "auto", [VELOCITY_KERNEL_SCALAR] = "scalar",
+    [VELOCITY_KERNEL_SSE2] = "sse2", [VELOCITY_KERNEL_AVX2] = "avx2",
+    [VELOCITY_KERNEL_NEON] = "neon",
+};
+
+bool velocityKernelParse(const char *name, VelocityKernel *k)
+{
+    for (size_t i = 0; i < sizeof(KERNEL_NAMES) / sizeof(*KERNEL_NAMES);
+         i += 1) {
+        if (strcmp(name, KERNEL_NAMES[i]) == 0) {
+            *k = (VelocityKernel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *velocityKernelName() { return KERNEL_NAMES[kernelResolve()]; }
+
+void velocityUpdate(Vector2 *vel, const Vector2 *targetVel,
+                    int *velTransitionTime, size_t count, float damping)
+{
+    VelocityFn fn = velocityScalar;
+
+    switch (kernelResolve()) {
+#ifdef HAVE_X86
+    case VELOCITY_KERNEL_SSE2:
+        fn = velocitySse2;
+        break;
+    case VELOCITY_KERNEL_AVX2:
+        fn = velocityAvx2;
+        break;
+#endif
+#ifdef HAVE_NEON
+    case VELOCITY_KERNEL_NEON:
+        fn = velocityNeon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    fn(vel, targetVel, velTransitionTime, count, damping);
+}
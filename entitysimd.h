@@ -0,0 +1,31 @@
+#ifndef ENTITYSIMD_H
+#define ENTITYSIMD_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Batched velocity step of the movement model: entities still in their
+// transition interpolate towards targetVel and count velTransitionTime down,
+// stopped ones (velTransitionTime == -1) are damped.
+//
+// Every kernel performs the same float operations in the same order without
+// fused multiply-adds, so all of them give bit identical results and replays
+// stay deterministic whatever the CPU picks.
+typedef enum VelocityKernel {
+    VELOCITY_KERNEL_AUTO = 0,
+    VELOCITY_KERNEL_SCALAR,
+    VELOCITY_KERNEL_SSE2,
+    VELOCITY_KERNEL_AVX2,
+    VELOCITY_KERNEL_NEON,
+} VelocityKernel;
+
+// false when k is not available on this CPU, the choice is left unchanged
+bool velocityKernelSet(VelocityKernel k);
+bool velocityKernelParse(const char *name, VelocityKernel *k);
+const char *velocityKernelName();
+
+void velocityUpdate(Vector2 *vel, const Vector2 *targetVel,
+                    int *velTransitionTime, size_t count, float damping);
+
+#endif
@@ -0,0 +1,425 @@
+#include "fontcache.h"
+
+#include <rlgl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "hash.h"
+
+// glyphs with larger bitmaps are drawn blank
+#define STAGING_SIDE (FONT_MAX_SIZE * 2)
+// missing glyphs rasterized by one LoadFontData()
+#define RASTER_BATCH 64
+// shelves come in heights of multiples of this, glyphs of about the same
+// height share them
+#define SHELF_STEP 8
+
+static unsigned char *fileRead(const char *path, int *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    unsigned char *data = NULL;
+    long len = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        len = ftell(f);
+    }
+    if (len > 0 && len <= INT32_MAX && fseek(f, 0, SEEK_SET) == 0) {
+        data = allocMem(ALLOC_OTHER, (size_t)len);
+        if (fread(data, (size_t)len, 1, f) != 1) {
+            allocFree(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    *size = (int)len;
+    return data;
+}
+
+bool fontCacheLoad(FontCache *c, const char *path)
+{
+    memset(c, 0, sizeof(*c));
+    c->data = fileRead(path, &c->dataSize);
+    if (c->data == NULL) {
+        return false;
+    }
+
+    // one glyph tells whether raylib can read the file at all
+    int probe = 'A';
+    GlyphInfo *glyph =
+        LoadFontData(c->data, c->dataSize, 16, &probe, 1, FONT_DEFAULT);
+    if (glyph == NULL) {
+        fontCacheUnload(c);
+        return false;
+    }
+    UnloadFontData(glyph, 1);
+
+    // white everywhere, glyphs only write their coverage into alpha so the
+    // tint is the colour of the text
+    size_t pixels = (size_t)FONT_ATLAS_SIZE * FONT_ATLAS_SIZE;
+    unsigned char *blank = allocMem(ALLOC_RENDER, pixels * 2);
+    for (size_t i = 0; i < pixels; i += 1) {
+        blank[i * 2] = 255;
+    }
+    Image image = {
+        .data = blank,
+        .width = FONT_ATLAS_SIZE,
+        .height = FONT_ATLAS_SIZE,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA,
+    };
+    c->atlas = LoadTextureFromImage(image);
+    allocFree(blank);
+
+    c->staging = allocMem(ALLOC_RENDER, STAGING_SIDE * STAGING_SIDE * 2);
+    c->loaded = true;
+    return true;
+}
+
+void fontCacheUnload(FontCache *c)
+{
+    if (c->loaded) {
+        UnloadTexture(c->atlas);
+    }
+    allocFree(c->staging);
+    allocFree(c->data);
+    memset(c, 0, sizeof(*c));
+}
+
+static unsigned int glyphHash(int codepoint, int size)
+{
+    return hash32((uint32_t)codepoint * 131u + (uint32_t)size) &
+           (FONT_MAX_GLYPHS - 1);
+}
+
+static FontGlyph *glyphFind(FontCache *c, int codepoint, int size)
+{
+    // the table is never full, so there always is a free slot to stop at
+    for (unsigned int i = glyphHash(codepoint, size);;
+         i = (i + 1) & (FONT_MAX_GLYPHS - 1)) {
+        FontGlyph *g = &c->glyphs[i];
+        if (g->codepoint == 0) {
+            return NULL;
+        }
+        if (g->codepoint == codepoint && g->size == size) {
+            return g;
+        }
+    }
+}
+
+// Free slot i and move the glyphs after it that probed past it back, so
+// every glyph stays reachable from its hash without tombstones
+static void glyphRemove(FontCache *c, unsigned int i)
+{
+    const unsigned int mask = FONT_MAX_GLYPHS - 1;
+    for (unsigned int j = (i + 1) & mask; c->glyphs[j].codepoint != 0;
+         j = (j + 1) & mask) {
+        const FontGlyph *g = &c->glyphs[j];
+        unsigned int home = glyphHash(g->codepoint, g->size);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            c->glyphs[i] = *g;
+            i = j;
+        }
+    }
+    c->glyphs[i] = (FontGlyph){0};
+    c->glyphsLen -= 1;
+}
+
+static void shelfEvict(FontCache *c, int shelf)
+{
+    // a removal can move a later glyph into slot i, which is looked at again
+    for (unsigned int i = 0; i < FONT_MAX_GLYPHS;) {
+        if (c->glyphs[i].codepoint != 0 && c->glyphs[i].shelf == shelf) {
+            glyphRemove(c, i);
+        } else {
+            i += 1;
+        }
+    }
+    c->shelves[shelf].x = 0;
+    c->evicted += 1;
+}
+
+static void atlasReset(FontCache *c)
+{
+    memset(c->glyphs, 0, sizeof(c->glyphs));
+    c->glyphsLen = 0;
+    c->shelvesLen = 0;
+    c->resets += 1;
+}
+
+// the least recently used shelf at least height tall that nothing drawn
+// this frame is on, -1 when there is none
+static int shelfLeastUsed(const FontCache *c, int height)
+{
+    int best = -1;
+    for (int i = 0; i < c->shelvesLen; i += 1) {
+        const FontShelf *s = &c->shelves[i];
+        if (s->height >= height && s->lastUsed != c->frame &&
+            (best < 0 || s->lastUsed < c->shelves[best].lastUsed)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Room for a width x height bitmap, evicting what has to go for it
+static int atlasPlace(FontCache *c, int width, int height, Rectangle *rect)
+{
+    // a pixel apart so filtering does not bleed into the neighbours
+    int w = width + 1;
+    int h = height + 1;
+    int shelfHeight = (h + SHELF_STEP - 1) / SHELF_STEP * SHELF_STEP;
+
+    int shelf = -1;
+    for (int i = 0; i < c->shelvesLen && shelf < 0; i += 1) {
+        const FontShelf *s = &c->shelves[i];
+        if (s->height == shelfHeight && s->x + w <= FONT_ATLAS_SIZE) {
+            shelf = i;
+        }
+    }
+
+    if (shelf < 0 && c->shelvesLen < FONT_MAX_SHELVES) {
+        int bottom = 0;
+        if (c->shelvesLen > 0) {
+            const FontShelf *last = &c->shelves[c->shelvesLen - 1];
+            bottom = last->y + last->height;
+        }
+        if (bottom + shelfHeight <= FONT_ATLAS_SIZE) {
+            shelf = c->shelvesLen;
+            c->shelves[shelf] = (FontShelf){bottom, shelfHeight, 0, 0};
+            c->shelvesLen += 1;
+        }
+    }
+
+    if (shelf < 0) {
+        shelf = shelfLeastUsed(c, h);
+        if (shelf >= 0) {
+            shelfEvict(c, shelf);
+        }
+    }
+
+    if (shelf < 0) {
+        // nothing tall enough is free, start over
+        atlasReset(c);
+        shelf = 0;
+        c->shelves[0] = (FontShelf){0, shelfHeight, 0, 0};
+        c->shelvesLen = 1;
+    }
+
+    FontShelf *s = &c->shelves[shelf];
+    *rect = (Rectangle){(float)s->x, (float)s->y, (float)width, (float)height};
+    s->x += w;
+    s->lastUsed = c->frame;
+    return shelf;
+}
+
+static void glyphInsert(FontCache *c, int codepoint, int size,
+                        const GlyphInfo *info)
+{
+    if (c->glyphsLen >= FONT_MAX_GLYPHS * 3 / 4) {
+        // the table gets slow when it fills up, make room like the atlas.
+        // Blanks are on no shelf, when they fill it start over so the table
+        // never runs full.
+        int shelf = shelfLeastUsed(c, 0);
+        int before = c->glyphsLen;
+        if (shelf >= 0) {
+            shelfEvict(c, shelf);
+        }
+        if (c->glyphsLen == before) {
+            atlasReset(c);
+        }
+    }
+
+    FontGlyph g = {
+        .codepoint = codepoint,
+        .size = size,
+        .shelf = -1,
+        .advanceX = size / 2,
+    };
+    if (info != NULL) {
+        g.offsetX = info->offsetX;
+        g.offsetY = info->offsetY;
+        g.advanceX = info->advanceX;
+
+        Image image = info->image;
+        if (image.data != NULL && image.width > 0 && image.height > 0 &&
+            image.width <= STAGING_SIDE && image.height <= STAGING_SIDE &&
+            image.format == PIXELFORMAT_UNCOMPRESSED_GRAYSCALE) {
+            g.shelf = atlasPlace(c, image.width, image.height, &g.rect);
+
+            const unsigned char *coverage = image.data;
+            int len = image.width * image.height;
+            for (int i = 0; i < len; i += 1) {
+                c->staging[i * 2] = 255;
+                c->staging[i * 2 + 1] = coverage[i];
+            }
+            // text batched before may still sample what is overwritten
+            rlDrawRenderBatchActive();
+            UpdateTextureRec(c->atlas, g.rect, c->staging);
+        }
+    }
+
+    // after placing, evictions move glyphs around
+    unsigned int i = glyphHash(codepoint, size);
+    while (c->glyphs[i].codepoint != 0) {
+        i = (i + 1) & (FONT_MAX_GLYPHS - 1);
+    }
+    c->glyphs[i] = g;
+    c->glyphsLen += 1;
+    c->rasterized += 1;
+}
+
+static void glyphsRasterize(FontCache *c, int *codepoints, int len, int size)
+{
+    GlyphInfo *infos = LoadFontData(c->data, c->dataSize, size, codepoints,
+                                    len, FONT_DEFAULT);
+    for (int i = 0; i < len; i += 1) {
+        // blanks when it failed, so they are not tried again every frame
+        glyphInsert(c, codepoints[i], size, infos != NULL ? &infos[i] : NULL);
+    }
+    if (infos != NULL) {
+        UnloadFontData(infos, len);
+    }
+}
+
+static int nextCodepoint(const char **text)
+{
+    int bytes = 0;
+    int codepoint = GetCodepoint(*text, &bytes);
+    *text += bytes > 0 ? bytes : 1;
+    return codepoint;
+}
+
+// rasterize what text is missing at size in as few LoadFontData() as
+// possible, each of them parses the font again
+static void glyphsEnsure(FontCache *c, const char *text, int size)
+{
+    int missing[RASTER_BATCH];
+    int len = 0;
+    for (const char *p = text; *p != '\0';) {
+        int codepoint = nextCodepoint(&p);
+        bool queued = false;
+        for (int i = 0; i < len && !queued; i += 1) {
+            queued = missing[i] == codepoint;
+        }
+        if (codepoint == '\n' || queued ||
+            glyphFind(c, codepoint, size) != NULL) {
+            continue;
+        }
+
+        missing[len] = codepoint;
+        len += 1;
+        if (len == RASTER_BATCH) {
+            glyphsRasterize(c, missing, len, size);
+            len = 0;
+        }
+    }
+    if (len > 0) {
+        glyphsRasterize(c, missing, len, size);
+    }
+}
+
+// the glyph, rasterized now if an eviction took it since glyphsEnsure()
+static const FontGlyph *glyphGet(FontCache *c, int codepoint, int size)
+{
+    FontGlyph *g = glyphFind(c, codepoint, size);
+    if (g == NULL) {
+        glyphsRasterize(c, &codepoint, 1, size);
+        g = glyphFind(c, codepoint, size);
+    }
+    if (g != NULL && g->shelf >= 0) {
+        c->shelves[g->shelf].lastUsed = c->frame;
+    }
+    return g;
+}
+
+static int rasterSize(int size)
+{
+    if (size < 1) {
+        return 1;
+    }
+    return size < FONT_MAX_SIZE ? size : FONT_MAX_SIZE;
+}
+
+static float glyphAdvance(const FontGlyph *g)
+{
+    return g->advanceX != 0 ? (float)g->advanceX : g->rect.width;
+}
+
+void fontCachePrewarm(FontCache *c, const char *text, int size)
+{
+    if (c->loaded) {
+        glyphsEnsure(c, text, rasterSize(size));
+    }
+}
+
+void fontCacheDraw(FontCache *c, const char *text, int x, int y, int size,
+                   Color color)
+{
+    if (!c->loaded) {
+        DrawText(text, x, y, size, color);
+        return;
+    }
+
+    int raster = rasterSize(size);
+    float scale = (float)size / (float)raster;
+    c->frame += 1;
+    glyphsEnsure(c, text, raster);
+
+    Vector2 pen = {(float)x, (float)y};
+    for (const char *p = text; *p != '\0';) {
+        int codepoint = nextCodepoint(&p);
+        if (codepoint == '\n') {
+            pen = (Vector2){(float)x, pen.y + size + FONT_LINE_SPACING};
+            continue;
+        }
+
+        const FontGlyph *g = glyphGet(c, codepoint, raster);
+        if (g == NULL) {
+            continue;
+        }
+        if (g->shelf >= 0) {
+            Rectangle dest = {
+                pen.x + g->offsetX * scale,
+                pen.y + g->offsetY * scale,
+                g->rect.width * scale,
+                g->rect.height * scale,
+            };
+            DrawTexturePro(c->atlas, g->rect, dest, (Vector2){0, 0}, 0,
+                           color);
+        }
+        pen.x += glyphAdvance(g) * scale;
+    }
+}
+
+int fontCacheMeasure(FontCache *c, const char *text, int size)
+{
+    if (!c->loaded) {
+        return MeasureText(text, size);
+    }
+
+    int raster = rasterSize(size);
+    float scale = (float)size / (float)raster;
+    c->frame += 1;
+    glyphsEnsure(c, text, raster);
+
+    float width = 0;
+    float line = 0;
+    for (const char *p = text; *p != '\0';) {
+        int codepoint = nextCodepoint(&p);
+        if (codepoint == '\n') {
+            line = 0;
+            continue;
+        }
+        const FontGlyph *g = glyphGet(c, codepoint, raster);
+        if (g != NULL) {
+            line += glyphAdvance(g) * scale;
+        }
+        width = line > width ? line : width;
+    }
+    return (int)(width + 0.5f);
+}
@@ -0,0 +1,75 @@
+#ifndef FONTCACHE_H
+#define FONTCACHE_H
+
+#include <raylib.h>
+#include <stdbool.h>
+
+// Text in a TrueType font rasterized on demand
+//
+// A glyph is rasterized the first time its codepoint is drawn or measured
+// at a size and packed into a shelf of one atlas texture shared by every
+// size, so only what is actually drawn costs time and VRAM. The atlas is
+// FONT_ATLAS_SIZE pixels square, which caps its memory. When it is full the
+// shelf drawn from least recently is emptied for the new glyph, and when no
+// shelf is tall enough the whole atlas starts over.
+//
+// Sizes above FONT_MAX_SIZE are rasterized at FONT_MAX_SIZE and scaled up.
+// Without a font file, or when it does not load, text goes to raylib's
+// default font through DrawText() and MeasureText() instead. Render thread
+// only.
+#define FONT_ATLAS_SIZE 1024
+#define FONT_MAX_SIZE 96
+#define FONT_MAX_GLYPHS 2048 // a power of two
+#define FONT_MAX_SHELVES 128
+#define FONT_LINE_SPACING 2
+
+typedef struct FontGlyph {
+    int codepoint; // 0 for a free slot
+    int size;
+    Rectangle rect; // in the atlas
+    int offsetX;
+    int offsetY;
+    int advanceX;
+    int shelf; // -1 for blanks, which take no room in the atlas
+} FontGlyph;
+
+typedef struct FontShelf {
+    int y;
+    int height;
+    int x; // where the next glyph goes
+    unsigned int lastUsed;
+} FontShelf;
+
+typedef struct FontCache {
+    bool loaded;
+    unsigned char *data; // the font file
+    int dataSize;
+    Texture2D atlas;
+    unsigned char *staging; // a glyph converted to the atlas' format
+
+    FontGlyph glyphs[FONT_MAX_GLYPHS]; // open addressing
+    int glyphsLen;
+    FontShelf shelves[FONT_MAX_SHELVES];
+    int shelvesLen;
+    unsigned int frame; // counts the draws and measures
+
+    // since fontCacheLoad()
+    int rasterized;
+    int evicted; // shelves emptied
+    int resets;  // times the whole atlas started over
+} FontCache;
+
+// false when path is not a font, the cache then draws with the default font
+bool fontCacheLoad(FontCache *c, const char *path);
+void fontCacheUnload(FontCache *c);
+
+// rasterize the glyphs of text at size ahead of time, for text that is known
+// to be drawn so its first frame does not pay for it
+void fontCachePrewarm(FontCache *c, const char *text, int size);
+
+// like DrawText() and MeasureText(), text is UTF-8
+void fontCacheDraw(FontCache *c, const char *text, int x, int y, int size,
+                   Color color);
+int fontCacheMeasure(FontCache *c, const char *text, int size);
+
+#endif
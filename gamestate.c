@@ -0,0 +1,84 @@
+#include "gamestate.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "hash.h"
+
+GameState *gameStateAlloc()
+{
+    return allocMem(ALLOC_ENTITIES, sizeof(GameState));
+}
+
+void gameStateFree(GameState *s) { allocFree(s); }
+
+void gameStateBind(GameState *s, EntityStore *store)
+{
+    *store = (EntityStore){
+        .pos = s->pos,
+        .prevPos = s->prevPos,
+        .vel = s->vel,
+        .targetVel = s->targetVel,
+        .velTransitionTime = s->velTransitionTime,
+        .maxVel = s->maxVel,
+        .radius = s->radius,
+        .len = s->len,
+        .capacity = MAX_ENTITIES,
+    };
+}
+
+void gameStateSave(GameState *dest, GameState *live, const EntityStore *store)
+{
+    live->len = store->len;
+    memcpy(dest, live, sizeof(*dest));
+}
+
+void gameStateRestore(GameState *live, EntityStore *store,
+                      const GameState *src)
+{
+    memcpy(live, src, sizeof(*live));
+    store->len = live->len;
+}
+
+void gameStateCopy(GameState *dest, const GameState *src)
+{
+    size_t len = src->len;
+    memcpy(dest->pos, src->pos, len * sizeof(*src->pos));
+    memcpy(dest->prevPos, src->prevPos, len * sizeof(*src->prevPos));
+    memcpy(dest->vel, src->vel, len * sizeof(*src->vel));
+    memcpy(dest->targetVel, src->targetVel, len * sizeof(*src->targetVel));
+    memcpy(dest->velTransitionTime, src->velTransitionTime,
+           len * sizeof(*src->velTransitionTime));
+    memcpy(dest->maxVel, src->maxVel, len * sizeof(*src->maxVel));
+    memcpy(dest->radius, src->radius, len * sizeof(*src->radius));
+
+    // everything after the arrays
+    size_t tail = offsetof(GameState, len);
+    memcpy((char *)dest + tail, (const char *)src + tail,
+           sizeof(*dest) - tail);
+}
+
+uint32_t gameStateHash(const GameState *s)
+{
+    // entityStoreHash() only reads
+    EntityStore view = {
+        .pos = (Vector2 *)s->pos,
+        .vel = (Vector2 *)s->vel,
+        .velTransitionTime = (int *)s->velTransitionTime,
+        .len = s->len,
+    };
+    uint32_t h = entityStoreHash(&view);
+
+    uint64_t accumulator;
+    memcpy(&accumulator, &s->accumulator, sizeof(accumulator));
+    const uint32_t rest[] = {
+        (uint32_t)s->frame, (uint32_t)accumulator,
+        (uint32_t)(accumulator >> 32), s->moveHeld,
+        s->stopPending, s->worldSeed,
+    };
+    for (size_t i = 0; i < sizeof(rest) / sizeof(*rest); i += 1) {
+        h = hash32(h ^ rest[i]);
+    }
+    return h;
+}
@@ -0,0 +1,60 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "entity.h"
+
+// Everything the game needs to carry on from a point in time
+//
+// A GameState is plain old data of a fixed size: the entities are stored
+// inline at full capacity and the world as the seed its chunks are generated
+// from, so saving or restoring one is a single memcpy. The live state is a
+// GameState too, the EntityStore bound to it by gameStateBind() works on its
+// arrays in place and only its len has to be carried over.
+//
+// The simulation draws no random numbers, the crowd's headings are hashed
+// from frame, which makes frame the state of its random generator.
+#define MAX_ENTITIES 16384
+#define PLAYER 0 // entity index of the player, the rest is the crowd
+
+typedef struct GameState {
+    // first, so they are aligned like allocMem() aligns arrays
+    Vector2 pos[MAX_ENTITIES];
+    Vector2 prevPos[MAX_ENTITIES];
+    Vector2 vel[MAX_ENTITIES];
+    Vector2 targetVel[MAX_ENTITIES];
+    int velTransitionTime[MAX_ENTITIES];
+    float maxVel[MAX_ENTITIES];
+    float radius[MAX_ENTITIES];
+    size_t len;
+
+    uint32_t worldSeed; // the level, when there is one, is for the whole run
+    size_t frame;       // update() calls
+    double accumulator; // time simulate() has not stepped yet
+    unsigned moveHeld;  // movement keys and buttons held down
+    bool stopPending;
+    Vector2 directionVector;
+    Camera2D camera;
+} GameState;
+
+GameState *gameStateAlloc();
+void gameStateFree(GameState *s);
+
+// points the arrays of store into s, the store takes s's len
+void gameStateBind(GameState *s, EntityStore *store);
+// copy live, with the len of the store bound to it, into dest
+void gameStateSave(GameState *dest, GameState *live, const EntityStore *store);
+// copy src into live and the store bound to it
+void gameStateRestore(GameState *live, EntityStore *store,
+                      const GameState *src);
+// dest = src like a memcpy would, but only the entities in use are copied,
+// for copies made every frame
+void gameStateCopy(GameState *dest, const GameState *src);
+// hash of the simulated state, the entities hash like entityStoreHash()
+uint32_t gameStateHash(const GameState *s);
+
+#endif
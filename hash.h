@@ -0,0 +1,18 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+
+// Integer hash (lowbias32), good enough to derive reproducible pseudo random
+// values from an index without keeping any generator state
+static inline uint32_t hash32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include "input.h"
+
+#include <stddef.h>
+
+static const int MOUSE_BUTTONS[] = {MOUSE_BUTTON_LEFT, MOUSE_BUTTON_RIGHT};
+#define MOUSE_BUTTONS_LEN                                                      \
+    (int)(sizeof(MOUSE_BUTTONS) / sizeof(MOUSE_BUTTONS[0]))
+
+// state seen by the last poll
+static int heldKeys[MAX_HELD_KEYS];
+static int heldKeysLen = 0;
+static size_t untrackedKeys = 0;
+static bool mouseHeld[MOUSE_BUTTONS_LEN] = {0};
+static Vector2 lastMouse = {0};
+static bool lastMouseValid = false;
+
+void inputFrameClear(InputFrame *f)
+{
+    f->len = 0;
+    f->dropped = 0;
+}
+
+bool inputFramePush(InputFrame *f, InputEvent e)
+{
+    if (f->len == MAX_INPUT_EVENTS) {
+        f->dropped += 1;
+        return false;
+    }
+    f->events[f->len] = e;
+    f->len += 1;
+    return true;
+}
+
+size_t inputUntrackedKeys() { return untrackedKeys; }
+
+static bool keyHeld(int key)
+{
+    for (int i = 0; i < heldKeysLen; i += 1) {
+        if (heldKeys[i] == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void inputPoll(InputFrame *f, Camera2D cam)
+{
+    Vector2 mouse = GetMousePosition();
+    Vector2 world = GetScreenToWorld2D(mouse, cam);
+
+    // releases first, a key pressed again within the same frame shows up as
+    // up then down instead of being swallowed
+    for (int i = 0; i < heldKeysLen;) {
+        if (IsKeyDown(heldKeys[i])) {
+            i += 1;
+            continue;
+        }
+        inputFramePush(f, (InputEvent){INPUT_KEY_UP, heldKeys[i], world});
+        heldKeysLen -= 1;
+        heldKeys[i] = heldKeys[heldKeysLen];
+    }
+
+    for (int key = GetKeyPressed(); key != 0; key = GetKeyPressed()) {
+        if (keyHeld(key)) {
+            continue;
+        }
+        inputFramePush(f, (InputEvent){INPUT_KEY_DOWN, key, world});
+        if (!IsKeyDown(key)) {
+            // already released again before this poll
+            inputFramePush(f, (InputEvent){INPUT_KEY_UP, key, world});
+        } else if (heldKeysLen < MAX_HELD_KEYS) {
+            heldKeys[heldKeysLen] = key;
+            heldKeysLen += 1;
+        } else {
+            // still held, its release will not be seen but claiming it came
+            // already would stop whatever it started
+            untrackedKeys += 1;
+        }
+    }
+
+    if (!lastMouseValid || mouse.x != lastMouse.x || mouse.y != lastMouse.y) {
+        // consecutive moves within one frame collapse into the last one
+        InputEvent move = {INPUT_MOUSE_MOVE, 0, world};
+        if (f->len > 0 && f->events[f->len - 1].type == INPUT_MOUSE_MOVE) {
+            f->events[f->len - 1] = move;
+        } else {
+            inputFramePush(f, move);
+        }
+        lastMouse = mouse;
+        lastMouseValid = true;
+    }
+
+    for (int i = 0; i < MOUSE_BUTTONS_LEN; i += 1) {
+        int button = MOUSE_BUTTONS[i];
+        bool down =
+            IsMouseButtonDown(button) || IsMouseButtonPressed(button);
+        if (down != mouseHeld[i]) {
+            inputFramePush(f, (InputEvent){
+                                  down ? INPUT_MOUSE_DOWN : INPUT_MOUSE_UP,
+                                  button,
+                                  world,
+                              });
+            mouseHeld[i] = down;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Input events batched per frame
+//
+// inputPoll() drains every key press raylib queued since the last poll and
+// compares the watched keys and mouse buttons against their state at the
+// previous poll, so a key pressed and released within one frame still yields
+// both edges. Events are appended to the frame in the order they were seen,
+// polling twice in a frame only adds what changed in between.
+//
+// Edge state and the buffers belong to the thread that polls, a frame can be
+// copied by value to whoever consumes it.
+
+#define MAX_INPUT_EVENTS 64
+// keys whose release is tracked at once
+#define MAX_HELD_KEYS 32
+
+typedef enum InputEventType {
+    INPUT_KEY_DOWN,
+    INPUT_KEY_UP,
+    INPUT_MOUSE_DOWN,
+    INPUT_MOUSE_UP,
+    INPUT_MOUSE_MOVE,
+} InputEventType;
+
+typedef struct InputEvent {
+    uint8_t type;
+    int16_t code; // raylib key or mouse button
+    Vector2 pos;  // mouse position in world space, for mouse events
+} InputEvent;
+
+typedef struct InputFrame {
+    InputEvent events[MAX_INPUT_EVENTS];
+    int len;
+    int dropped; // events that did not fit
+} InputFrame;
+
+void inputFrameClear(InputFrame *f);
+// false when the frame is full
+bool inputFramePush(InputFrame *f, InputEvent e);
+
+// append everything that happened since the last poll, mouse positions are
+// converted with cam
+void inputPoll(InputFrame *f, Camera2D cam);
+// presses of keys held while MAX_HELD_KEYS others were, only their down edge
+// was reported
+size_t inputUntrackedKeys();
+
+#endif
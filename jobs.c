@@ -0,0 +1,280 @@
+#include "jobs.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "messages.h"
+
+// upper bound on chunks per jobsParallelFor(), bigger ranges get bigger
+// chunks so the jobs fit on the caller's stack
+#define MAX_JOBS_PER_CALL 256
+#define DEQUE_CAPACITY 1024
+// failed steal rounds before a worker goes to sleep
+#define IDLE_SPINS 64
+
+_Static_assert(MAX_MESSAGE_PRODUCERS >= MAX_JOB_THREADS + 1,
+               "every worker and the pipeline thread get a message queue");
+
+typedef struct Job {
+    JobFn fn;
+    void *data;
+    size_t begin;
+    size_t end;
+    atomic_size_t *pending;
+} Job;
+
+// Chase-Lev deque, the owner pushes and pops at the bottom and thieves take
+// from the top
+typedef struct Deque {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    _Atomic(Job *) slots[DEQUE_CAPACITY];
+} Deque;
+
+static Deque deques[MAX_JOB_THREADS];
+static pthread_t workers[MAX_JOB_THREADS];
+static int threadCount = 1; // workers plus the thread that called init
+static int workersStarted = 0;
+// deques in use, threads attached with jobsAttachThread() come after the
+// workers
+static atomic_int dequesLen = 1;
+// 0 is the thread that called init, -1 a thread without a deque
+static _Thread_local int threadIndex = -1;
+
+// jobs sitting in any deque, workers sleep while it is 0
+static atomic_int queued = 0;
+static atomic_bool shuttingDown = false;
+static pthread_mutex_t sleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleepCond = PTHREAD_COND_INITIALIZER;
+
+static bool dequePush(Deque *d, Job *job)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= DEQUE_CAPACITY) {
+        return false;
+    }
+
+    atomic_store_explicit(&d->slots[b % DEQUE_CAPACITY], job,
+                          memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+static Job *dequePop(Deque *d)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    Job *job = atomic_load_explicit(&d->slots[b % DEQUE_CAPACITY],
+                                    memory_order_relaxed);
+    if (t == b) {
+        // last one, race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(
+                &d->top, &t, t + 1, memory_order_seq_cst,
+                memory_order_relaxed)) {
+            job = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+static Job *dequeSteal(Deque *d)
+{
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b) {
+        return NULL;
+    }
+
+    Job *job = atomic_load_explicit(&d->slots[t % DEQUE_CAPACITY],
+                                    memory_order_acquire);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return job;
+}
+
+static void jobRun(Job *job)
+{
+    atomic_fetch_sub_explicit(&queued, 1, memory_order_relaxed);
+    job->fn(job->data, job->begin, job->end);
+    atomic_fetch_sub_explicit(job->pending, 1, memory_order_release);
+}
+
+// Own deque first, then steal starting from a different victim per thread
+static Job *jobFind()
+{
+    Job *job = dequePop(&deques[threadIndex]);
+    if (job != NULL) {
+        return job;
+    }
+
+    int len = atomic_load_explicit(&dequesLen, memory_order_acquire);
+    for (int i = 1; i < len; i += 1) {
+        job = dequeSteal(&deques[(threadIndex + i) % len]);
+        if (job != NULL) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static void *workerMain(void *arg)
+{
+    threadIndex = (int)(intptr_t)arg;
+    // jobs may log to the on screen messages, without a queue they are
+    // dropped
+    bool registered = messagesRegisterProducer();
+    assert(registered);
+    (void)registered;
+
+    int idle = 0;
+    while (!atomic_load(&shuttingDown)) {
+        Job *job = jobFind();
+        if (job != NULL) {
+            jobRun(job);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < IDLE_SPINS) {
+            sched_yield();
+            continue;
+        }
+
+        pthread_mutex_lock(&sleepLock);
+        while (atomic_load(&queued) == 0 && !atomic_load(&shuttingDown)) {
+            pthread_cond_wait(&sleepCond, &sleepLock);
+        }
+        pthread_mutex_unlock(&sleepLock);
+        idle = 0;
+    }
+    return NULL;
+}
+
+void jobsInit(int threads)
+{
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    // one deque is left for jobsAttachThread()
+    if (threads > MAX_JOB_THREADS - 1) {
+        threads = MAX_JOB_THREADS - 1;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    atomic_store(&shuttingDown, false);
+    threadIndex = 0;
+    // set before any worker reads it, shrunk to the workers that started
+    atomic_store(&dequesLen, threads);
+    workersStarted = 0;
+    for (int i = 1; i < threads; i += 1) {
+        if (pthread_create(&workers[i], NULL, workerMain,
+                           (void *)(intptr_t)i) != 0) {
+            break;
+        }
+        workersStarted += 1;
+    }
+    threadCount = workersStarted + 1;
+    atomic_store(&dequesLen, threadCount);
+}
+
+void jobsShutdown()
+{
+    pthread_mutex_lock(&sleepLock);
+    atomic_store(&shuttingDown, true);
+    pthread_cond_broadcast(&sleepCond);
+    pthread_mutex_unlock(&sleepLock);
+
+    for (int i = 1; i <= workersStarted; i += 1) {
+        pthread_join(workers[i], NULL);
+    }
+    threadCount = 1;
+    atomic_store(&dequesLen, 1);
+    workersStarted = 0;
+}
+
+int jobsThreadCount() { return threadCount; }
+
+bool jobsAttachThread()
+{
+    int i = atomic_load(&dequesLen);
+    do {
+        if (i >= MAX_JOB_THREADS) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&dequesLen, &i, i + 1));
+
+    threadIndex = i;
+    return true;
+}
+
+void jobsParallelFor(size_t count, size_t chunk, JobFn fn, void *data)
+{
+    if (chunk == 0) {
+        chunk = 1;
+    }
+    if (threadCount == 1 || threadIndex < 0 || count <= chunk) {
+        fn(data, 0, count);
+        return;
+    }
+
+    size_t jobsLen = (count + chunk - 1) / chunk;
+    if (jobsLen > MAX_JOBS_PER_CALL) {
+        jobsLen = MAX_JOBS_PER_CALL;
+        chunk = (count + jobsLen - 1) / jobsLen;
+        jobsLen = (count + chunk - 1) / chunk;
+    }
+
+    Job jobs[MAX_JOBS_PER_CALL];
+    atomic_size_t pending = jobsLen;
+    Deque *own = &deques[threadIndex];
+
+    // push in reverse so the owner pops the chunks in order
+    for (size_t i = jobsLen; i-- > 0;) {
+        size_t begin = i * chunk;
+        size_t end = begin + chunk < count ? begin + chunk : count;
+        jobs[i] = (Job){fn, data, begin, end, &pending};
+
+        atomic_fetch_add_explicit(&queued, 1, memory_order_relaxed);
+        if (!dequePush(own, &jobs[i])) {
+            // deque is full, do it ourselves
+            jobRun(&jobs[i]);
+        }
+    }
+
+    pthread_mutex_lock(&sleepLock);
+    pthread_cond_broadcast(&sleepCond);
+    pthread_mutex_unlock(&sleepLock);
+
+    // help until our chunks are done, possibly running other callers' jobs
+    while (atomic_load_explicit(&pending, memory_order_acquire) > 0) {
+        Job *job = jobFind();
+        if (job != NULL) {
+            jobRun(job);
+        } else {
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Job system with one work stealing deque per thread
+//
+// jobsParallelFor() splits a range into chunks, pushes them onto the calling
+// thread's deque and works on them until all are done while idle workers
+// steal from it. It is a barrier: when it returns every chunk has finished
+// and its writes are visible. It can be called from inside a job.
+//
+// With a single thread everything runs inline on the caller.
+#define MAX_JOB_THREADS 64
+
+// fn runs on [begin, end)
+typedef void (*JobFn)(void *data, size_t begin, size_t end);
+
+// threads includes the calling thread, 0 picks the number of cores
+void jobsInit(int threads);
+void jobsShutdown();
+int jobsThreadCount();
+// Give a thread that was not started by the job system its own deque so it
+// can call jobsParallelFor() too, call after jobsInit(). A thread without
+// one runs its jobs inline.
+bool jobsAttachThread();
+
+void jobsParallelFor(size_t count, size_t chunk, JobFn fn, void *data);
+
+#endif
@@ -0,0 +1,161 @@
+#include "level.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc.h"
+
+static const char MAGIC[4] = {'L', 'E', 'V', 'L'};
+
+_Static_assert(sizeof(Building) == 20, "level records are 20 bytes");
+_Static_assert(sizeof(LevelHeader) % 4 == 0 && sizeof(LevelChunk) % 4 == 0,
+               "level sections have to stay aligned for Building");
+
+// the buildings of a chunk have to be sorted by their left edge for the
+// spatial index and lie within the chunk for culling and collisions
+static bool levelChunkValid(const Building *b, uint32_t len, int64_t index)
+{
+    float start = (float)index * CHUNK_WIDTH;
+    float end = start + CHUNK_WIDTH;
+    for (uint32_t i = 0; i < len; i += 1) {
+        Rectangle r = b[i].rect;
+        // written so NaN fails too
+        if (!(r.x >= start && r.width >= 0 && r.x + r.width <= end &&
+              r.height >= 0 && (i == 0 || b[i - 1].rect.x <= r.x))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checks the header, the directory and every building, so a broken file is
+// refused here instead of tripping up the world later
+static bool levelValid(const Level *l)
+{
+    if (l->size < sizeof(LevelHeader)) {
+        return false;
+    }
+    const LevelHeader *h = l->map;
+    if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        h->version != LEVEL_VERSION || h->chunkWidth != CHUNK_WIDTH) {
+        return false;
+    }
+
+    size_t size = sizeof(LevelHeader) + h->chunkCount * sizeof(LevelChunk) +
+                  (size_t)h->buildingCount * sizeof(Building);
+    if (size > l->size) {
+        return false;
+    }
+
+    const LevelChunk *chunks = (const LevelChunk *)(h + 1);
+    const Building *buildings = (const Building *)(chunks + h->chunkCount);
+    for (uint32_t i = 0; i < h->chunkCount; i += 1) {
+        if (chunks[i].count > CHUNK_MAX_BUILDINGS ||
+            chunks[i].first > h->buildingCount ||
+            chunks[i].count > h->buildingCount - chunks[i].first ||
+            !levelChunkValid(buildings + chunks[i].first, chunks[i].count,
+                             (int64_t)h->firstChunk + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool levelOpen(Level *l, const char *path)
+{
+    *l = (Level){0};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    l->map = map;
+    l->size = st.st_size;
+
+    if (!levelValid(l)) {
+        levelClose(l);
+        return false;
+    }
+
+    const LevelHeader *h = l->map;
+    l->firstChunk = h->firstChunk;
+    l->chunkCount = (int)h->chunkCount;
+    l->chunks = (const LevelChunk *)(h + 1);
+    l->buildings = (const Building *)(l->chunks + h->chunkCount);
+    return true;
+}
+
+void levelClose(Level *l)
+{
+    if (l->map != NULL) {
+        munmap(l->map, l->size);
+    }
+    *l = (Level){0};
+}
+
+const Building *levelChunk(const Level *l, int index, int *len)
+{
+    int i = index - l->firstChunk;
+    if (i < 0 || i >= l->chunkCount) {
+        *len = 0;
+        return NULL;
+    }
+    *len = (int)l->chunks[i].count;
+    return l->buildings + l->chunks[i].first;
+}
+
+bool levelExport(const char *path, uint32_t seed, int firstChunk,
+                 int chunkCount)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+
+    // generated twice, once for the directory and once for the records, so
+    // only one chunk is ever held
+    Chunk *c = allocMem(ALLOC_LEVEL, sizeof(*c));
+    LevelHeader h = {
+        .version = LEVEL_VERSION,
+        .chunkWidth = CHUNK_WIDTH,
+        .firstChunk = firstChunk,
+        .chunkCount = (uint32_t)chunkCount,
+    };
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+
+    LevelChunk *chunks = allocMem(ALLOC_LEVEL, chunkCount * sizeof(*chunks));
+    for (int i = 0; i < chunkCount; i += 1) {
+        chunkGenerate(c, NULL, seed, firstChunk + i);
+        chunks[i] = (LevelChunk){h.buildingCount, (uint32_t)c->len};
+        h.buildingCount += (uint32_t)c->len;
+    }
+
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(chunks, sizeof(*chunks), chunkCount, f) ==
+                  (size_t)chunkCount;
+    for (int i = 0; ok && i < chunkCount; i += 1) {
+        chunkGenerate(c, NULL, seed, firstChunk + i);
+        ok = fwrite(c->buildings, sizeof(Building), c->len, f) ==
+             (size_t)c->len;
+    }
+
+    allocFree(c);
+    allocFree(chunks);
+    return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,58 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "world.h"
+
+// Binary level files
+//
+// A level covers chunkCount chunks starting at firstChunk. The file is
+// mapped read-only and its records are used in place as the buildings of
+// the chunks, opening one costs an mmap and a check of the directory no
+// matter how large it is.
+//
+// Layout, native byte order, every section 4 byte aligned:
+//   LevelHeader
+//   LevelChunk[chunkCount]      buildings of chunk firstChunk + i
+//   Building[buildingCount]     20 bytes each, sorted by x within a chunk
+
+#define LEVEL_VERSION 1
+
+typedef struct LevelHeader {
+    char magic[4]; // "LEVL"
+    uint32_t version;
+    uint32_t chunkWidth; // has to match CHUNK_WIDTH
+    int32_t firstChunk;
+    uint32_t chunkCount;
+    uint32_t buildingCount;
+} LevelHeader;
+
+typedef struct LevelChunk {
+    uint32_t first;
+    uint32_t count;
+} LevelChunk;
+
+typedef struct Level {
+    void *map;
+    size_t size;
+
+    int firstChunk;
+    int chunkCount;
+    const LevelChunk *chunks;
+    const Building *buildings;
+} Level;
+
+bool levelOpen(Level *l, const char *path);
+void levelClose(Level *l);
+
+// buildings of chunk index, none outside the level
+const Building *levelChunk(const Level *l, int index, int *len);
+
+// write chunkCount chunks of the procedural world seed from firstChunk on
+bool levelExport(const char *path, uint32_t seed, int firstChunk,
+                 int chunkCount);
+
+#endif
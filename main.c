@@ -2,349 +2,749 @@
 #include <math.h>
 #include <raylib.h>
 #include <raymath.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloc.h"
+#include "binlog.h"
+#include "collide.h"
+#include "entity.h"
+#include "entitybatch.h"
+#include "entitysimd.h"
+#include "fontcache.h"
+#include "gamestate.h"
+#include "hash.h"
+#include "input.h"
+#include "jobs.h"
+#include "level.h"
+#include "messages.h"
+#include "overlay.h"
+#include "pacer.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "replay.h"
+#include "sim.h"
+#include "tilecache.h"
+#include "world.h"
 
-Vector2 Vector2Polate(Vector2 curr, Vector2 dest, float t)
+// Global varibales
+// the live game state and the store working on its entities, what setup()
+// made is kept in resetState for R and F5 saves to quickSave for F9
+static GameState *game = NULL;
+static GameState *resetState = NULL;
+static GameState *quickSave = NULL;
+static EntityStore entities = {0};
+static size_t agentsLen = 0;
+// --rollback N, headless runs simulate the last N frames again every frame
+// and check they end up in the live state
+static SimHistory rollback = {0};
+
+static void gameStatesInit()
 {
-    float dx = dest.x - curr.x;
-    float dy = dest.y - curr.y;
-    return (Vector2){
-        .x = curr.x + (dx)*0.5 * t * t + dx * t,
-        .y = curr.y + (dy)*0.5 * t * t + dy * t,
-    };
+    game = gameStateAlloc();
+    resetState = gameStateAlloc();
+    gameStateBind(game, &entities);
 }
 
-const float GRAVITY = 0.3;
+static void gameStatesFree()
+{
+    gameStateFree(game);
+    gameStateFree(resetState);
+    gameStateFree(quickSave);
+    simHistoryFree(&rollback);
+    game = resetState = quickSave = NULL;
+    entities = (EntityStore){0};
+}
 
-const size_t PLAYER_VEL_TRANSITION_FRAMES = 30;
-typedef struct Player {
-    Vector2 pos;
-    Vector2 vel;
-    Vector2 targetVel;
+#define SCREEN_WIDTH 1280
+#define SCREEN_HEIGHT 720
 
-    size_t maxVel;
-    size_t radius;
-    int velTransitionTime;
-} Player;
+// Without a window there is no screen, so we pretend it is SCREEN_WIDTH x
+// SCREEN_HEIGHT and feed simulate() scripted input
+static bool headless = false;
 
-// Message queue to display on screen
-#define MAX_MESSAGES_LEN 100
-static const char *messages[MAX_MESSAGES_LEN] = {0};
+static bool showProfiler = true;
+static const char *TRACE_PATH = "leep-trace.json";
 
-static size_t messagesIndex = 0;
-static size_t messagesLen = 0;
+static inline int screenWidth()
+{
+    return headless ? SCREEN_WIDTH : GetScreenWidth();
+}
 
-bool isInQueue(size_t index)
+static inline int screenHeight()
 {
-    return index >= messagesIndex && index < messagesIndex + messagesLen;
+    return headless ? SCREEN_HEIGHT : GetScreenHeight();
 }
 
-void messagesDebug(bool printAllMemory)
+static World world = {0};
+static Level level = {0}; // --level, mapped for the whole run
+// the simulation's own view of the buildings, see collide.h
+static Collider collider = {0};
+// where the crowd starts out, also what --export-level writes
+static const Rectangle CROWD_AREA = {-6000, 0, 13000, 500};
+// the skyline rendered into tiles, drawn instead of the chunks when enabled,
+// one cache per level of detail so zooming back and forth keeps both and
+// zoomed out tiles cover more of the world with the same texture size
+static TileCache skylineTiles[WORLD_LOD_LEVELS] = {
+    [WORLD_LOD_SILHOUETTE] = {.worldSize = TILE_SIZE * 4},
+};
+static bool useSkylineTiles = true;
+// mouse wheel zoom of the camera, render only so it is not part of the input
+#define MIN_ZOOM 0.125f
+#define MAX_ZOOM 1.0f
+#define ZOOM_STEP 1.25f
+
+static Pacer pacer = {0};
+
+// the crowd drawn instanced, immediate mode when instancing is not available
+static EntityBatch crowdBatch = {0};
+static bool crowdBatchReady = false;
+static Color crowdColors[MAX_ENTITIES];
+static bool showCrowdVelocity = false;
+
+// the message queue, rendered again only when it changed
+static OverlayCache messageOverlay = {0};
+
+// --font, the HUD falls back to the default font without one
+static const char *hudFontPath = NULL;
+static FontCache hudFont = {0};
+
+static void hudText(const char *text, int x, int y, int fontSize, Color color)
 {
-    printf("messages = {\n");
-    printf("\t.index = %li,\n", messagesIndex);
-    printf("\t.len = %li,\n", messagesLen);
-    printf("\t.data = {\n");
-    size_t stopIndex = printAllMemory ? MAX_MESSAGES_LEN : messagesLen;
-    for (size_t i = 0; i < stopIndex; i += 1) {
-        size_t messages_i = (i + messagesIndex) % MAX_MESSAGES_LEN;
-        printf("\t\t");
-        if (isInQueue(messages_i)) {
-            printf("\"%s\",\n", messages[messages_i]);
-        } else {
-            printf("*\"%s\",\n", messages[messages_i]);
-        }
-    }
-    printf("\t}\n");
-    printf("}\n");
+    fontCacheDraw(&hudFont, text, x, y, fontSize, color);
 }
 
-void messagesPut(const char *m)
+static int hudMeasure(const char *text, int fontSize)
 {
-    if (messagesLen > MAX_MESSAGES_LEN) {
-        fprintf(stderr, "MESSAGE QUEUE DROPPING MESSAGES...\n");
-        messagesLen -= 1;
-        messagesIndex = (messagesIndex + 1) % MAX_MESSAGES_LEN;
-        // remove first message
-    }
+    return fontCacheMeasure(&hudFont, text, fontSize);
+}
 
-    messages[(messagesIndex + messagesLen) % MAX_MESSAGES_LEN] = m;
-    messagesLen += 1;
-    // messagesDebug(false);
+// Split screen between up to MAX_VIEWS cameras, F6 cycles through 1, 2 and 4
+// views, and a minimap toggled with F7. The simulation has a single player,
+// the other views follow the first crowd agents in place of more players.
+// All views share the streaming, the culling and the skyline tiles.
+#define MAX_VIEWS 4
+#define MINIMAP_ZOOM (1.0f / 16)
+#define MINIMAP_WIDTH 320
+#define MINIMAP_HEIGHT 180
+
+typedef struct View {
+    Camera2D camera;
+    Rectangle viewport; // screen pixels
+    Rectangle area;     // what it shows of the world
+    WorldLod lod;
+    size_t follows; // entity at its center
+    bool minimap;
+} View;
+
+static int splitViews = 1;
+static bool showMinimap = false;
+
+// start the world over with a different seed
+static void worldReset(uint32_t seed)
+{
+    // chunks are generated as they come into view
+    worldInit(&world, seed);
+    colliderReset(&collider, world.level, world.seed);
+    for (int i = 0; i < WORLD_LOD_LEVELS; i += 1) {
+        tileCacheInvalidate(&skylineTiles[i]);
+    }
 }
 
-static inline bool messagesIsEmpty() { return messagesLen == 0; }
+static Vector2 screenCenter()
+{
+    return (Vector2){(float)screenWidth() / 2, (float)screenHeight() / 2};
+}
 
-const char *messagesGet()
+void setup()
 {
-    if (messagesLen == 0) {
-        return NULL;
+    worldReset((uint32_t)GetRandomValue(0, 0x7fffffff));
+
+    game->worldSeed = world.seed;
+    game->frame = 0;
+    game->accumulator = 0;
+    game->moveHeld = 0;
+    game->stopPending = false;
+    game->camera = (Camera2D){
+        .offset = screenCenter(),
+        .rotation = 0,
+        .zoom = 1,
+    };
+    entityStoreClear(&entities);
+    // above the tallest building
+    entityAdd(&entities,
+              (Player){
+                  .pos = {0, GROUND_Y - MAX_BUILDING_HEIGHT - 20},
+                  .radius = 10,
+                  .maxVel = 10,
+                  .velTransitionTime = -1,
+              });
+
+    // scatter the crowd over the skyline
+    for (size_t i = 0; i < agentsLen; i += 1) {
+        uint32_t h = hash32(i);
+        entityAdd(&entities,
+                  (Player){
+                      .pos =
+                          {
+                              CROWD_AREA.x + h % (int)CROWD_AREA.width,
+                              CROWD_AREA.y + (h >> 16) % (int)CROWD_AREA.height,
+                          },
+                      .radius = 4,
+                      .maxVel = 6,
+                      .velTransitionTime = -1,
+                  });
     }
 
-    size_t outIndex = messagesIndex;
-    assert(isInQueue(outIndex));
-
-    messagesIndex = (messagesIndex + 1) % MAX_MESSAGES_LEN;
-    messagesLen -= 1;
-    const char *out = messages[outIndex];
-    messages[outIndex] = NULL;
-    return out;
+    game->directionVector = (Vector2){0};
+    gameStateSave(resetState, game, &entities);
 }
 
-void messagesDestroy()
+// Continue from a saved state, the chunks of the running world stay cached
+// when it is the saved world, which is the case for anything saved this run
+static void gameRestore(const GameState *s)
 {
-    while (!messagesIsEmpty()) {
-        free((void *)messagesGet());
+    gameStateRestore(game, &entities, s);
+    // the frames before were not simulated from here
+    simHistoryClear(&rollback);
+    if (game->worldSeed != world.seed) {
+        worldReset(game->worldSeed);
     }
+    // the window may have been resized since
+    game->camera.offset = screenCenter();
 }
 
-void playerUpdate(Player *p)
+// World space bounding box of what the camera shows in viewport, in screen
+// pixels
+Rectangle cameraView(Camera2D cam, Rectangle viewport)
 {
-    p->pos.x += p->vel.x;
-    p->pos.y += p->vel.y;
-
-    if (p->velTransitionTime > 0) {
-        Vector2 newVel = Vector2Polate(
-            p->vel, p->targetVel,
-            1 - (p->velTransitionTime / (float)PLAYER_VEL_TRANSITION_FRAMES));
+    float x1 = viewport.x + viewport.width;
+    float y1 = viewport.y + viewport.height;
+    const Vector2 corners[] = {
+        GetScreenToWorld2D((Vector2){viewport.x, viewport.y}, cam),
+        GetScreenToWorld2D((Vector2){x1, viewport.y}, cam),
+        GetScreenToWorld2D((Vector2){viewport.x, y1}, cam),
+        GetScreenToWorld2D((Vector2){x1, y1}, cam),
+    };
 
-        p->velTransitionTime -= 1;
-        p->vel = newVel;
-    } else if (p->velTransitionTime == -1) {
-        p->vel = Vector2Scale(p->vel, 0.9);
+    Vector2 min = corners[0];
+    Vector2 max = corners[0];
+    for (size_t i = 1; i < sizeof(corners) / sizeof(*corners); i += 1) {
+        min = Vector2Min(min, corners[i]);
+        max = Vector2Max(max, corners[i]);
     }
+
+    return (Rectangle){min.x, min.y, max.x - min.x, max.y - min.y};
 }
 
-void messagesNew(const char *fmt, ...)
+// data points to the WorldLod to draw
+void skylineDraw(Rectangle area, void *data)
 {
-    va_list argsp;
-    va_start(argsp, fmt);
+    worldDraw(&world, area, *(const WorldLod *)data);
+}
+
+// Deterministic stand-in for a player used by the headless benchmark: walks a
+// W/A/S/D square, clicks around the player and occasionally clears messages
+// and resets the level
+void scriptedInput(InputFrame *f, size_t frame)
+{
+    static const int MOVE_KEYS[] = {KEY_W, KEY_D, KEY_S, KEY_A};
+    int moveKey = MOVE_KEYS[(frame / 60) % 4];
+
+    inputFrameClear(f);
 
-    const size_t MAX_STR_LEN = 255;
-    char *buff = MemAlloc(MAX_STR_LEN * sizeof(char));
-    vsnprintf(buff, MAX_STR_LEN, fmt, argsp);
-    puts(buff);
-    va_end(argsp);
+    if (frame % 60 == 0) {
+        inputFramePush(f,
+                       (InputEvent){.type = INPUT_KEY_DOWN, .code = moveKey});
+    } else if (frame % 60 == 40) {
+        inputFramePush(f, (InputEvent){.type = INPUT_KEY_UP, .code = moveKey});
+    }
+
+    int key = 0;
+    if (frame % 500 == 250) {
+        key = KEY_C;
+    } else if (frame % 2000 == 1999) {
+        key = KEY_R;
+    }
+    if (key != 0) {
+        inputFramePush(f, (InputEvent){.type = INPUT_KEY_DOWN, .code = key});
+        inputFramePush(f, (InputEvent){.type = INPUT_KEY_UP, .code = key});
+    }
 
-    messagesPut(buff);
+    if (frame % 90 == 45) {
+        float angle = frame * 0.37f;
+        Vector2 m = Vector2Add(entities.pos[PLAYER],
+                               (Vector2){cosf(angle) * 300, sinf(angle) * 300});
+        inputFramePush(f, (InputEvent){INPUT_MOUSE_DOWN, MOUSE_BUTTON_LEFT, m});
+    } else if (frame % 90 == 46) {
+        inputFramePush(f, (InputEvent){.type = INPUT_MOUSE_UP,
+                                       .code = MOUSE_BUTTON_LEFT});
+    }
 }
 
-void playerStop(Player *p)
+// Keys that act on the render thread's state or reset the whole world, run
+// on the render thread while the simulation is idle
+static void command(int key)
 {
-    if (p->velTransitionTime == 0) {
-        p->velTransitionTime = -1;
+    switch (key) {
+    case KEY_R:
+        gameRestore(resetState);
+        messagesClear();
+        break;
+    case KEY_F5:
+        if (quickSave == NULL) {
+            quickSave = gameStateAlloc();
+        }
+        gameStateSave(quickSave, game, &entities);
+        messagesNew("saved");
+        break;
+    case KEY_F9:
+        if (quickSave != NULL) {
+            gameRestore(quickSave);
+            messagesNew("loaded the save");
+        } else {
+            messagesNew("nothing saved, F5 saves");
+        }
+        break;
+    case KEY_C:
+        messagesClear();
+        break;
+    case KEY_BACKSPACE:
+        messagesGet();
+        break;
+    case KEY_F1:
+        showProfiler = !showProfiler;
+        break;
+    case KEY_F3:
+        useSkylineTiles = !useSkylineTiles;
+        break;
+    case KEY_F4:
+        showCrowdVelocity = !showCrowdVelocity;
+        break;
+    case KEY_F6:
+        splitViews = splitViews == MAX_VIEWS ? 1 : splitViews * 2;
+        break;
+    case KEY_F7:
+        showMinimap = !showMinimap;
+        break;
+    case KEY_F2:
+        if (profileDumpTrace(TRACE_PATH)) {
+            messagesNew("trace written to %s", TRACE_PATH);
+        } else {
+            messagesNew("failed to write %s", TRACE_PATH);
+        }
+        break;
     }
 }
-void playerMove(Player *p, Vector2 direction)
+
+void handleCommands(const InputFrame *in)
 {
-    static int moveNum = 0;
+    for (int i = 0; i < in->len; i += 1) {
+        const InputEvent *e = &in->events[i];
+        if (e->type == INPUT_KEY_DOWN) {
+            command(e->code);
+        } else if (e->type == INPUT_MOUSE_DOWN &&
+                   e->code == MOUSE_BUTTON_LEFT) {
+            // not part of the simulation, which has to stay quiet when
+            // frames are simulated again
+            messagesNew("mouse clicked v = {%.2f, %.2f}", e->pos.x, e->pos.y);
+        }
+    }
+}
 
-    p->velTransitionTime = PLAYER_VEL_TRANSITION_FRAMES;
+// What draw() reads of the simulation. The simulation writes the back buffer
+// while the render thread draws the front one and they are swapped once both
+// are done, the camera is derived from it on the render thread.
+typedef struct WorldSnapshot {
+    Vector2 *pos;
+    Vector2 *prevPos;
+    Vector2 *vel;
+    float *radius;
+    size_t len;
 
-    if (p->maxVel / Vector2Length(direction) < 1.0) {
-        direction = Vector2Scale(Vector2Normalize(direction), p->maxVel);
-    }
+    Player player;
+    Vector2 directionVector;
+    float alpha; // how far into the next step, see simulate()
 
-    moveNum += 1;
-    p->targetVel = direction;
+    double inputTime; // when the newest input in this state was polled
+    uint64_t simNs;   // how long producing it took
+} WorldSnapshot;
 
-    // messagesNew("vel: {%.2f, %.2f}", p->vel.x, p->vel.y);
-}
+static WorldSnapshot snapshots[2] = {0};
+static int snapshotFront = 0;
 
-// Global varibales
-static Player player;
-static Camera2D playerCam;
+typedef struct SimRequest {
+    InputFrame in;
+    double frameTime;
+    double inputTime;
+} SimRequest;
 
-#define MAX_BUILDINGS 100
-static Rectangle buildings[MAX_BUILDINGS] = {0};
-static Color buildColors[MAX_BUILDINGS] = {0};
+static SimRequest simRequest = {0};
 
-Vector2 directionVector;
+void snapshotsInit(size_t capacity)
+{
+    for (int i = 0; i < 2; i += 1) {
+        snapshots[i] = (WorldSnapshot){
+            .pos = allocMem(ALLOC_ENTITIES, capacity * sizeof(Vector2)),
+            .prevPos = allocMem(ALLOC_ENTITIES, capacity * sizeof(Vector2)),
+            .vel = allocMem(ALLOC_ENTITIES, capacity * sizeof(Vector2)),
+            .radius = allocMem(ALLOC_ENTITIES, capacity * sizeof(float)),
+        };
+    }
+}
 
-void setup()
+void snapshotsFree()
 {
-    int spacing = 0;
+    for (int i = 0; i < 2; i += 1) {
+        allocFree(snapshots[i].pos);
+        allocFree(snapshots[i].prevPos);
+        allocFree(snapshots[i].vel);
+        allocFree(snapshots[i].radius);
+        snapshots[i] = (WorldSnapshot){0};
+    }
+}
 
-    for (int i = 0; i < MAX_BUILDINGS; i++) {
-        buildings[i].width = (float)GetRandomValue(50, 200);
-        buildings[i].height = (float)GetRandomValue(100, 800);
-        buildings[i].y = GetScreenHeight() - 130.0f - buildings[i].height;
-        buildings[i].x = -6000.0f + spacing;
+void snapshotWrite(WorldSnapshot *w, float alpha, double inputTime)
+{
+    w->len = entities.len;
+    memcpy(w->pos, entities.pos, w->len * sizeof(*w->pos));
+    memcpy(w->prevPos, entities.prevPos, w->len * sizeof(*w->prevPos));
+    memcpy(w->vel, entities.vel, w->len * sizeof(*w->vel));
+    memcpy(w->radius, entities.radius, w->len * sizeof(*w->radius));
+
+    w->player = entityGet(&entities, PLAYER);
+    w->directionVector = game->directionVector;
+    w->alpha = alpha;
+    w->inputTime = inputTime;
+}
 
-        spacing += (int)buildings[i].width;
+void snapshotSwap() { snapshotFront = 1 - snapshotFront; }
 
-        buildColors[i] =
-            (Color){GetRandomValue(200, 240), GetRandomValue(200, 240),
-                    GetRandomValue(200, 250), 255};
-    }
+// One frame of simulation into the back snapshot, runs on the pipeline
+// thread when pipelining
+void simFrame(void *data)
+{
+    const SimRequest *req = data;
+    uint64_t start = profileNowNs();
 
-    playerCam = (Camera2D){
-        .offset = {(float)GetScreenWidth() / 2, (float)GetScreenHeight() / 2},
-        .rotation = 0,
-        .zoom = 1,
-    };
-    player = (Player){
-        .radius = 10,
-        .maxVel = 10,
-        .velTransitionTime = -1,
-    };
+    float alpha = simulate(game, &collider, &req->in, req->frameTime);
 
-    directionVector = (Vector2){0};
+    WorldSnapshot *back = &snapshots[1 - snapshotFront];
+    snapshotWrite(back, alpha, req->inputTime);
+    back->simNs = profileNowNs() - start;
 }
 
-void update()
+static Vector2 snapshotLerpPos(const WorldSnapshot *w, size_t i)
 {
+    return Vector2Lerp(w->prevPos[i], w->pos[i], w->alpha);
+}
 
-    playerCam.target = (Vector2){player.pos.x + 20, player.pos.y + 20};
-    // playerVel.y += GRAVITY;
-    playerUpdate(&player);
-
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-        Vector2 m = GetScreenToWorld2D(GetMousePosition(), playerCam);
+// smoothed time from polling input to presenting the frame that shows it
+static double inputLatency = 0;
 
-        messagesNew("mouse clicked v = {%.2f, %.2f}", m.x, m.y);
+// what a steady state frame must not do, new blocks and resizes
+static size_t allocCount(AllocStats s) { return s.allocs + s.resizes; }
 
-        directionVector = Vector2Subtract(m, player.pos);
-        playerMove(&player, directionVector);
+// heap use of every subsystem and the allocations made since the last call
+static void drawAllocStats(int x, int y)
+{
+    static size_t lastAllocs = 0;
+    AllocStats all = allocStats();
+    size_t frameAllocs = allocCount(all) - lastAllocs;
+    lastAllocs = allocCount(all);
+
+    hudText(TextFormat("allocs/frame %zu, heap %.1f KiB peak %.1f KiB",
+                       frameAllocs, all.bytes / 1024.0,
+                       all.peakBytes / 1024.0),
+            x, y, 10, frameAllocs > 0 ? RED : DARKGRAY);
+    for (int i = 0; i < ALLOC_TAGS; i += 1) {
+        AllocStats s = allocTagStats(i);
+        y += 12;
+        hudText(TextFormat("%s: %zu live, %.1f KiB peak %.1f KiB",
+                           allocTagName(i), s.allocs - s.frees,
+                           s.bytes / 1024.0, s.peakBytes / 1024.0),
+                x, y, 10, DARKGRAY);
     }
+}
 
-    if (!IsKeyDown(KEY_W) && !IsKeyDown(KEY_A) && !IsKeyDown(KEY_S) &&
-        !IsKeyDown(KEY_D) && !IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
-        playerStop(&player);
-    }
+static View viewMake(Camera2D camera, Rectangle viewport, size_t follows,
+                     bool minimap)
+{
+    camera.offset = (Vector2){viewport.x + viewport.width / 2,
+                              viewport.y + viewport.height / 2};
+    return (View){
+        .camera = camera,
+        .viewport = viewport,
+        .area = cameraView(camera, viewport),
+        .lod = worldLodForZoom(camera.zoom),
+        .follows = follows,
+        .minimap = minimap,
+    };
+}
 
-    switch (GetKeyPressed()) {
-    // need more button events to make it work the way i intend
-    // ideally it should call playerMove on only the first time
-    // that the button is IsKeyDown(), however that is not how
-    // GetKeyPressed is implemented so
-    //
-    // additionally playerMove should also be called onmousemove
-    // however i will need to track the coordinates of the mouse
-    // and setup some sort of event system in order for that to
-    // work properly because raylib does not support that
-    case KEY_R:
-        setup();
-        while (!messagesIsEmpty()) {
-            free((void *)messagesGet());
-        }
-        break;
-    case KEY_C:
-        while (!messagesIsEmpty()) {
-            free((void *)messagesGet());
-        }
-        break;
-    case KEY_BACKSPACE:
-        free((void *)messagesGet());
-        break;
-    case KEY_UP:
-        player.pos.y -= 10;
-        break;
-    case KEY_LEFT:
-        player.pos.x -= 10;
-        break;
-    case KEY_DOWN:
-        player.pos.y += 10;
-        break;
-    case KEY_RIGHT:
-        player.pos.x += 10;
-        break;
-    case KEY_W:
-        playerMove(&player, (Vector2){0, -10});
-        break;
-    case KEY_A:
-        playerMove(&player, (Vector2){-10, 0});
-        break;
-    case KEY_S:
-        playerMove(&player, (Vector2){0, 10});
-        break;
-    case KEY_D:
-        playerMove(&player, (Vector2){10, 0});
-        break;
+// The views of this frame, the player's first. Two views are stacked since
+// the world is wide and flat, four are the quadrants.
+static int viewsLayout(View *views, const WorldSnapshot *w)
+{
+    int columns = splitViews == 4 ? 2 : 1;
+    int rows = splitViews == 1 ? 1 : 2;
+    float width = (float)(GetScreenWidth() / columns);
+    float height = (float)(GetScreenHeight() / rows);
+
+    int len = 0;
+    for (int i = 0; i < splitViews; i += 1) {
+        size_t follows = (size_t)i < w->len ? (size_t)i : PLAYER;
+        Vector2 pos = snapshotLerpPos(w, follows);
+        Camera2D camera = game->camera;
+        camera.target = (Vector2){pos.x + 20, pos.y + 20};
+        Rectangle viewport = {(float)(i % columns) * width,
+                              (float)(i / columns) * height, width, height};
+        views[len] = viewMake(camera, viewport, follows, false);
+        len += 1;
     }
+    // mouse input goes through the player's camera
+    game->camera = views[0].camera;
+
+    if (showMinimap) {
+        Camera2D camera = {.target = views[0].camera.target,
+                           .zoom = MINIMAP_ZOOM};
+        Rectangle viewport = {
+            (float)(GetScreenWidth() - MINIMAP_WIDTH - 10),
+            (float)(GetScreenHeight() - MINIMAP_HEIGHT - 10), MINIMAP_WIDTH,
+            MINIMAP_HEIGHT};
+        views[len] = viewMake(camera, viewport, PLAYER, true);
+        len += 1;
+    }
+    return len;
 }
 
-void draw()
+// Draw one view of w, the crowd has been uploaded when crowdUploaded, returns
+// how many buildings it drew
+static int drawView(const View *v, const View *views, int viewsLen,
+                    const WorldSnapshot *w, const WorldVisible *visible,
+                    bool crowdUploaded)
 {
-    const size_t FONT_SIZE = 20;
+    Rectangle view = v->area;
+    BeginScissorMode((int)v->viewport.x, (int)v->viewport.y,
+                     (int)v->viewport.width, (int)v->viewport.height);
+    if (v->minimap) {
+        DrawRectangleRec(v->viewport, RAYWHITE);
+    }
+    BeginMode2D(v->camera);
 
-    ClearBackground(WHITE);
-    BeginMode2D(playerCam);
-    DrawRectangle(-6000, 590, 13000, 8000, DARKGRAY);
+    int buildingsDrawn = 0;
+    if (useSkylineTiles) {
+        tileCacheDraw(&skylineTiles[v->lod], view);
+    } else {
+        buildingsDrawn = worldDrawVisible(visible, view);
+    }
+
+    Player player = w->player;
+    Player drawn = player;
+    drawn.pos = snapshotLerpPos(w, PLAYER);
 
-    for (int i = 0; i < MAX_BUILDINGS; i++) {
-        DrawRectangleRec(buildings[i], buildColors[i]);
+    if (v->minimap) {
+        // where the other views are looking and the player, too small to
+        // see the crowd
+        for (int i = 0; i < viewsLen; i += 1) {
+            if (!views[i].minimap) {
+                DrawRectangleLinesEx(views[i].area, 2 / v->camera.zoom, RED);
+            }
+        }
+        DrawCircleV(drawn.pos, 3 / v->camera.zoom, BLACK);
+        EndMode2D();
+        EndScissorMode();
+        DrawRectangleLinesEx(v->viewport, 2, DARKGRAY);
+        return buildingsDrawn;
     }
 
-    DrawText(TextFormat("{%.2f, %.2f} %i", player.vel.x, player.vel.y,
-                        player.velTransitionTime),
-             playerCam.target.x, playerCam.target.y, FONT_SIZE, BLACK);
+    if (v == &views[0]) {
+        const int FONT_SIZE = 20;
+        hudText(TextFormat("{%.2f, %.2f} %i", player.vel.x, player.vel.y,
+                           player.velTransitionTime),
+                v->camera.target.x, v->camera.target.y, FONT_SIZE, BLACK);
+
+        hudText(TextFormat("{%.2f, %.2f} %i", player.targetVel.x,
+                           player.targetVel.y, player.velTransitionTime),
+                v->camera.target.x, v->camera.target.y + FONT_SIZE,
+                FONT_SIZE, BLACK);
+    }
 
-    DrawText(TextFormat("{%.2f, %.2f} %i", player.targetVel.x,
-                        player.targetVel.y, player.velTransitionTime),
-             playerCam.target.x, playerCam.target.y + FONT_SIZE, FONT_SIZE,
-             BLACK);
+    if (crowdBatchReady && w->len > 1) {
+        if (!crowdUploaded) {
+            // the crowd is everything after the player, drawn under it
+            EntityView crowd = {
+                .pos = w->pos + 1,
+                .prevPos = w->prevPos + 1,
+                .vel = w->vel + 1,
+                .radius = w->radius + 1,
+                .color = crowdColors,
+                .len = w->len - 1,
+                .alpha = w->alpha,
+            };
+            entityBatchDraw(&crowdBatch, &crowd);
+        } else {
+            entityBatchRedraw(&crowdBatch);
+        }
+        if (showCrowdVelocity) {
+            entityBatchDrawArrows(&crowdBatch, player.maxVel * 2,
+                                  1 / v->camera.zoom, RED);
+        }
+    }
+    for (size_t i = 1; i < w->len && !crowdBatchReady; i += 1) {
+        Vector2 pos = snapshotLerpPos(w, i);
+        float r = w->radius[i];
+        if (!CheckCollisionCircleRec(pos, r, view)) {
+            continue;
+        }
+        if (pacer.quality >= 1) {
+            DrawRectangleV((Vector2){pos.x - r, pos.y - r},
+                           (Vector2){r * 2, r * 2}, DARKBLUE);
+        } else {
+            DrawCircleV(pos, r, DARKBLUE);
+        }
+    }
 
-    DrawCircleV(player.pos, player.radius, BLACK);
+    DrawCircleV(drawn.pos, drawn.radius, BLACK);
 
-    DrawLineV(player.pos,
-              Vector2Add(player.pos, Vector2Scale(Vector2Normalize(player.vel),
-                                                  player.maxVel * 2)),
+    DrawLineV(drawn.pos,
+              Vector2Add(drawn.pos, Vector2Scale(Vector2Normalize(drawn.vel),
+                                                 drawn.maxVel * 2)),
               RED);
 
-    DrawLineV(player.pos, Vector2Add(player.pos, directionVector), PURPLE);
-    DrawLineV(player.pos,
-              Vector2Add(player.pos, Vector2Rotate(directionVector, 90)),
+    DrawLineV(drawn.pos, Vector2Add(drawn.pos, w->directionVector), PURPLE);
+    DrawLineV(drawn.pos,
+              Vector2Add(drawn.pos, Vector2Rotate(w->directionVector, 90)),
               ORANGE);
 
     EndMode2D();
+    EndScissorMode();
+    if (viewsLen > 1) {
+        DrawRectangleLinesEx(v->viewport, 1, GRAY);
+    }
+    return buildingsDrawn;
+}
 
-    static const float MESSAGE_LIFE = 2; // seconds
-    // remove messages every MESSAGE_LIFE seconds
-    static const char *message = NULL;
-    static double messageBirth = 0;
-    if (GetTime() - messageBirth > MESSAGE_LIFE) {
-        if (message != NULL) {
-            MemFree((void *)message);
-        }
+void draw(const WorldSnapshot *w)
+{
+    const size_t FONT_SIZE = 20;
+
+    float wheel = GetMouseWheelMove();
+    if (wheel != 0) {
+        float zoom = game->camera.zoom * powf(ZOOM_STEP, wheel);
+        game->camera.zoom = Clamp(zoom, MIN_ZOOM, MAX_ZOOM);
+    }
 
-        message = messagesGet();
-        if (message != NULL) {
-            messageBirth = GetTime();
+    View views[MAX_VIEWS + 1];
+    int viewsLen = viewsLayout(views, w);
+    WorldLod lod = views[0].lod;
+    TileCache *tiles = &skylineTiles[lod];
+
+    if (IsWindowResized()) {
+        // the tile pools are sized for the view, let them be reallocated
+        for (int i = 0; i < WORLD_LOD_LEVELS; i += 1) {
+            tileCacheUnload(&skylineTiles[i]);
         }
     }
 
-    // draw all messages in queue above player
-    for (size_t i = 0; i < messagesLen; i += 1) {
-        size_t messages_i = (i + messagesIndex) % MAX_MESSAGES_LEN;
-
-        const char *nextMessage = messages[messages_i];
-        if (nextMessage != NULL) {
-            int paddingLeft = 4;
-            int paddingRight = 4;
-            int paddingTop = 4;
-            int paddingBottom = 4;
-
-            int textY =
-                GetScreenHeight() -
-                ((FONT_SIZE + paddingBottom + paddingTop + 4) * (i + 1)) - 10;
-            int textX = 10;
-
-            size_t textWidth = MeasureText(nextMessage, FONT_SIZE);
-
-            if (textY >= (int)FONT_SIZE) {
-                DrawRectangle(textX - paddingLeft, textY - paddingTop,
-                              textWidth + (paddingLeft + paddingRight),
-                              FONT_SIZE + (paddingTop + paddingBottom),
-                              (Color){25, 25, 25, 39});
-                DrawText(nextMessage, textX, textY, FONT_SIZE, BLACK);
-            }
+    // the areas of all views, then grouped by level of detail
+    Rectangle areas[MAX_VIEWS + 1];
+    Rectangle lodAreas[WORLD_LOD_LEVELS][MAX_VIEWS + 1];
+    int lodAreasLen[WORLD_LOD_LEVELS] = {0};
+    for (int i = 0; i < viewsLen; i += 1) {
+        WorldLod l = views[i].lod;
+        areas[i] = views[i].area;
+        lodAreas[l][lodAreasLen[l]] = views[i].area;
+        lodAreasLen[l] += 1;
+    }
+
+    profileBegin("chunks");
+    worldUpdateAreas(&world, areas, viewsLen);
+    if (world.changed) {
+        for (int i = 0; i < WORLD_LOD_LEVELS; i += 1) {
+            tileCacheInvalidateArea(&skylineTiles[i], world.changedArea);
+        }
+    }
+    profileEnd();
+
+    // the pacer lowers the quality when frames keep missing their vblank:
+    // level 1 draws the crowd as squares when it is not instanced, level 2
+    // also halves the resolution of the skyline tiles
+    WorldVisible visible[WORLD_LOD_LEVELS];
+    for (int i = 0; i < WORLD_LOD_LEVELS; i += 1) {
+        WorldLod l = (WorldLod)i;
+        if (lodAreasLen[l] == 0) {
+            continue;
         }
+        if (useSkylineTiles) {
+            profileBegin("skyline tiles");
+            tileCacheSetTexels(&skylineTiles[l],
+                               pacer.quality >= 2 ? TILE_SIZE / 2 : 0);
+            tileCacheUpdateViews(&skylineTiles[l], lodAreas[l],
+                                 lodAreasLen[l], skylineDraw, &l);
+            profileEnd();
+        } else {
+            profileBegin("cull");
+            worldCull(&world, lodAreas[l], lodAreasLen[l], l, &visible[l]);
+            profileEnd();
+        }
+    }
+
+    ClearBackground(WHITE);
+
+    profileBegin("views");
+    int buildingsDrawn = 0;
+    for (int i = 0; i < viewsLen; i += 1) {
+        buildingsDrawn += drawView(&views[i], views, viewsLen, w,
+                                   &visible[views[i].lod], i > 0);
     }
+    profileEnd();
 
-    DrawText(TextFormat("%.2f", GetTime()), 10, 10, FONT_SIZE, GREEN);
-    DrawFPS(GetScreenWidth() - 100, 10);
+    // every message is shown for MESSAGE_LIFE_NS
+    static const uint64_t MESSAGE_LIFE_NS = 2000000000;
+    messagesExpire(MESSAGE_LIFE_NS);
+
+    // draw all messages in queue above player
+    profileBegin("messages");
+    overlayCacheDraw(&messageOverlay, FONT_SIZE, hudMeasure, hudText);
+    profileEnd();
+
+    hudText(TextFormat("%.2f", GetTime()), 10, 10, FONT_SIZE, GREEN);
+    if (messagesDropped() > 0) {
+        hudText(TextFormat("%zu messages dropped", messagesDropped()), 10,
+                10 + FONT_SIZE * 2, FONT_SIZE, RED);
+    }
+    if (binlogDropped() > 0) {
+        hudText(TextFormat("%zu log records dropped", binlogDropped()), 10,
+                10 + FONT_SIZE * 3, FONT_SIZE, RED);
+    }
+    if (useSkylineTiles) {
+        hudText(TextFormat("tiles %i drawn %i rendered %i pooled, lod %i",
+                           tiles->drawn, tiles->rendered, tiles->len, lod),
+                10, 10 + FONT_SIZE, FONT_SIZE, GREEN);
+    } else {
+        hudText(TextFormat("buildings %i, chunks %i resident %i generated",
+                           buildingsDrawn, world.resident, world.generated),
+                10, 10 + FONT_SIZE, FONT_SIZE, GREEN);
+    }
+    if (showProfiler) {
+        profileDrawGraph(GetScreenWidth() - PROFILE_FRAMES - 10, 10,
+                         PROFILE_FRAMES, 100);
+        hudText(TextFormat("sim %.2f ms, input latency %.1f ms",
+                           w->simNs / 1e6, inputLatency * 1e3),
+                GetScreenWidth() - PROFILE_FRAMES - 10, 10 + 100 + 4, 10,
+                DARKGRAY);
+        hudText(TextFormat("%i Hz, quality %i, %i of %i vblanks missed",
+                           pacer.refreshHz, pacer.quality, pacer.missed,
+                           PACER_WINDOW),
+                GetScreenWidth() - PROFILE_FRAMES - 10, 10 + 100 + 4 + 12,
+                10, pacer.missed > 0 ? RED : DARKGRAY);
+        drawAllocStats(GetScreenWidth() - PROFILE_FRAMES - 10,
+                       10 + 100 + 4 + 24);
+    }
 }
 
 static inline void CenterWindow(int monitorNumber)
@@ -366,30 +766,488 @@ int init()
         printf("mons[%li] = %s\n", i, GetMonitorName(i));
     }
 
-    InitWindow(1280, 720, "leep");
+    // frames are paced by VSync and pacer instead of SetTargetFPS()
+    SetConfigFlags(FLAG_VSYNC_HINT);
+    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "leep");
     SetWindowState(FLAG_WINDOW_RESIZABLE);
     CenterWindow(0);
 
-    SetTargetFPS(60);
+    pacerInit(&pacer);
+
+    crowdBatchReady = entityBatchInit(&crowdBatch, MAX_ENTITIES);
+    for (size_t i = 0; i < MAX_ENTITIES; i += 1) {
+        crowdColors[i] = DARKBLUE;
+    }
+
+    if (hudFontPath != NULL) {
+        if (fontCacheLoad(&hudFont, hudFontPath)) {
+            // what every frame draws, so the first frames do not stall
+            static const char HUD_GLYPHS[] =
+                "0123456789.,:-+{}% "
+                "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+            fontCachePrewarm(&hudFont, HUD_GLYPHS, 20);
+            fontCachePrewarm(&hudFont, HUD_GLYPHS, 10);
+        } else {
+            fprintf(stderr, "%s is not a font, using the default one\n",
+                    hudFontPath);
+        }
+    }
     return 1;
 }
 
-void deInit() { CloseWindow(); }
+void deInit()
+{
+    pipelineStop();
+    entityBatchUnload(&crowdBatch);
+    overlayCacheUnload(&messageOverlay);
+    fontCacheUnload(&hudFont);
+    for (int i = 0; i < WORLD_LOD_LEVELS; i += 1) {
+        tileCacheUnload(&skylineTiles[i]);
+    }
+    worldUnload(&world);
+    levelClose(&level);
+    snapshotsFree();
+    gameStatesFree();
+    jobsShutdown();
+    CloseWindow();
+    binlogStop();
+    allocReportLeaks();
+}
+
+static int compareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// --record and --replay, the replay replaces the input and frame times
+static bool recording = false;
+static bool replaying = false;
+
+// Close the recording and check the replay against the state it recorded,
+// returns the exit status
+static int replayFinish()
+{
+    Player p = entityGet(&entities, PLAYER);
+    ReplayResult result = {
+        .stateHash = entityStoreHash(&entities),
+        .state = {p.pos.x, p.pos.y, p.vel.x, p.vel.y},
+    };
+
+    int status = 0;
+    if (recording && !replayRecordEnd(result)) {
+        fprintf(stderr, "failed to write the recording\n");
+        status = 1;
+    }
+
+    if (replaying) {
+        ReplayResult expected;
+        uint32_t played = replayFramesPlayed();
+        if (!replayClose(&expected)) {
+            fprintf(stderr, "replay: recording is truncated or has data past "
+                            "its footer\n");
+            status = 1;
+        } else if (expected.frames != played) {
+            fprintf(stderr, "replay: stopped after %u of %u frames\n", played,
+                    expected.frames);
+            status = 1;
+        } else if (expected.stateHash != result.stateHash ||
+                   memcmp(expected.state, result.state,
+                          sizeof(result.state)) != 0) {
+            fprintf(stderr,
+                    "replay: diverged, state hash %08x, recorded %08x\n",
+                    result.stateHash, expected.stateHash);
+            status = 1;
+        } else {
+            printf("replay: matches the recording\n");
+        }
+    }
+    return status;
+}
+
+// --max-frame-ns, headless runs fail when their p99 frame time is above it
+static uint64_t maxFrameNs = 0;
+// --max-frame-allocs, headless runs fail when a frame past the warmup
+// allocates more often than this, negative turns the check off
+static long maxFrameAllocs = -1;
+#define ALLOC_WARMUP_FRAMES 60
 
-int main()
+// Run the simulation for a fixed number of 60Hz frames, or through a
+// replay, without a window and print frame time statistics
+int runHeadless(size_t frames, uint32_t seed)
 {
+    headless = true;
+    SetRandomSeed(seed);
+    setup();
+
+    size_t capacity = replaying ? 1024 : frames;
+    uint64_t *samples = allocMem(ALLOC_OTHER, capacity * sizeof(*samples));
+    uint64_t total = 0;
+    size_t worstAllocs = 0;
+
+    GameState *resim = rollback.capacity > 0 ? gameStateAlloc() : NULL;
+    uint64_t resimTotal = 0;
+    uint64_t resimWorst = 0;
+    size_t resimRuns = 0;
+    size_t diverged = 0;
+
+    size_t i = 0;
+    for (;; i += 1) {
+        InputFrame in;
+        double frameTime = 1.0 / 60;
+        if (replaying) {
+            if (!replayNextFrame(&frameTime, &in)) {
+                break;
+            }
+        } else if (i < frames) {
+            scriptedInput(&in, i);
+        } else {
+            break;
+        }
+        replayRecordFrame(frameTime, &in);
+
+        if (i == capacity) {
+            capacity *= 2;
+            samples = allocResize(ALLOC_OTHER, samples,
+                                  capacity * sizeof(*samples));
+        }
+
+        size_t allocsBefore = allocCount(allocStats());
+        uint64_t start = profileNowNs();
+        messagesMerge();
+        handleCommands(&in);
+        simHistoryPush(&rollback, game, &in, frameTime);
+        simulate(game, &collider, &in, frameTime);
+        samples[i] = profileNowNs() - start;
+        total += samples[i];
+
+        if (resim != NULL && rollback.len == rollback.capacity) {
+            uint64_t resimStart = profileNowNs();
+            simResimulate(&rollback, resim, &collider, rollback.len);
+            uint64_t resimNs = profileNowNs() - resimStart;
+            resimTotal += resimNs;
+            resimWorst = resimNs > resimWorst ? resimNs : resimWorst;
+            resimRuns += 1;
+            if (gameStateHash(resim) != gameStateHash(game) && diverged == 0) {
+                diverged = i + 1;
+            }
+        }
+
+        size_t frameAllocs = allocCount(allocStats()) - allocsBefore;
+        if (i >= ALLOC_WARMUP_FRAMES && frameAllocs > worstAllocs) {
+            worstAllocs = frameAllocs;
+        }
+
+        // stand in for the message expiry in draw()
+        if (i % 120 == 0) {
+            messagesGet();
+        }
+    }
+    frames = i;
+
+    int status = replayFinish();
+    if (frames == 0) {
+        fprintf(stderr, "replay: no frames recorded\n");
+        allocFree(samples);
+        gameStateFree(resim);
+        gameStatesFree();
+        return 1;
+    }
+
+    qsort(samples, frames, sizeof(*samples), compareU64);
+
+    printf("frames: %zu\n", frames);
+    printf("entities: %zu\n", entities.len);
+    printf("velocity kernel: %s\n", velocityKernelName());
+    printf("threads: %i\n", jobsThreadCount());
+    printf("state hash: %08x\n", entityStoreHash(&entities));
+    printf("ns/frame: %llu\n", (unsigned long long)(total / frames));
+    printf("p50: %llu ns\n", (unsigned long long)samples[frames / 2]);
+    printf("p99: %llu ns\n", (unsigned long long)samples[frames * 99 / 100]);
+    printf("max: %llu ns\n", (unsigned long long)samples[frames - 1]);
+    printf("max allocs/frame: %zu\n", worstAllocs);
+    printf("peak heap: %zu bytes\n", allocStats().peakBytes);
+    if (resimRuns > 0) {
+        printf("rollback %zu frames: %llu ns mean, %llu ns max\n",
+               rollback.capacity, (unsigned long long)(resimTotal / resimRuns),
+               (unsigned long long)resimWorst);
+    }
+
+    uint64_t p99 = samples[frames * 99 / 100];
+    if (maxFrameNs > 0 && p99 > maxFrameNs) {
+        fprintf(stderr, "frame time regressed: p99 %llu ns is over %llu ns\n",
+                (unsigned long long)p99, (unsigned long long)maxFrameNs);
+        status = 1;
+    }
+    if (maxFrameAllocs >= 0 && worstAllocs > (size_t)maxFrameAllocs) {
+        fprintf(stderr,
+                "steady state frames allocate: %zu allocations in a frame,"
+                " over %li\n",
+                worstAllocs, maxFrameAllocs);
+        status = 1;
+    }
+    if (diverged > 0) {
+        fprintf(stderr,
+                "rollback: frame %zu came out different when simulated "
+                "again\n",
+                diverged - 1);
+        status = 1;
+    }
+
+    allocFree(samples);
+    gameStateFree(resim);
+    messagesClear();
+    gameStatesFree();
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    bool runHeadlessMode = false;
+    size_t frames = 10000;
+    size_t rollbackFrames = 0;
+    int threads = 0;
+    bool pipelined = true;
+    const char *recordPath = NULL;
+    const char *replayPath = NULL;
+    const char *levelPath = NULL;
+    const char *exportPath = NULL;
+    const char *logPath = NULL;
+    bool seedSet = false;
+    uint32_t seed = 0;
+
+    for (int i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            runHeadlessMode = true;
+        } else if (strcmp(argv[i], "--no-pipeline") == 0) {
+            pipelined = false;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            levelPath = argv[++i];
+        } else if (strcmp(argv[i], "--export-level") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (strcmp(argv[i], "--font") == 0 && i + 1 < argc) {
+            hudFontPath = argv[++i];
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            logPath = argv[++i];
+        } else if (strcmp(argv[i], "--expand-log") == 0 && i + 1 < argc) {
+            const char *path = argv[++i];
+            if (!binlogExpand(path, stdout)) {
+                fprintf(stderr, "%s is not a log or is truncated\n", path);
+                return 1;
+            }
+            return 0;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+            seedSet = true;
+        } else if (strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc) {
+            world.uploadBudget = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-frame-ns") == 0 && i + 1 < argc) {
+            maxFrameNs = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-frame-allocs") == 0 &&
+                   i + 1 < argc) {
+            maxFrameAllocs = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--rollback") == 0 && i + 1 < argc) {
+            rollbackFrames = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--agents") == 0 && i + 1 < argc) {
+            agentsLen = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            VelocityKernel k;
+            const char *name = argv[++i];
+            if (!velocityKernelParse(name, &k) || !velocityKernelSet(k)) {
+                fprintf(stderr, "velocity kernel %s is not available\n",
+                        name);
+                return 1;
+            }
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--agents N] [--jobs N] [--no-pipeline]"
+                    " [--simd auto|scalar|sse2|avx2|neon]"
+                    " [--record FILE] [--replay FILE] [--upload-budget BYTES]"
+                    " [--seed N] [--level FILE] [--export-level FILE]"
+                    " [--log FILE] [--expand-log FILE] [--font FILE]"
+                    " [--headless [--frames N] [--max-frame-ns N]"
+                    " [--rollback N]]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    // headless runs are reproducible by default, so are replays since the
+    // recording decides the seed and the crowd
+    if (!seedSet) {
+        seed = runHeadlessMode ? 1 : (uint32_t)time(NULL);
+    }
+    if (replayPath != NULL) {
+        ReplayInfo info;
+        if (!replayOpen(replayPath, &info)) {
+            fprintf(stderr, "%s is not a recording\n", replayPath);
+            return 1;
+        }
+        replaying = true;
+        seed = info.seed;
+        agentsLen = info.agents;
+    }
+
+    if (agentsLen > MAX_ENTITIES - 1) {
+        fprintf(stderr, "--agents is limited to %i\n", MAX_ENTITIES - 1);
+        return 1;
+    }
+    if (runHeadlessMode && !replaying && frames == 0) {
+        fprintf(stderr, "--frames must be positive\n");
+        return 1;
+    }
+    if (recordPath != NULL) {
+        ReplayInfo info = {seed, (uint32_t)agentsLen};
+        if (!replayRecordBegin(recordPath, info)) {
+            fprintf(stderr, "failed to create %s\n", recordPath);
+            return 1;
+        }
+        recording = true;
+    }
+
+    if (levelPath != NULL) {
+        if (!levelOpen(&level, levelPath)) {
+            fprintf(stderr, "%s is not a level\n", levelPath);
+            return 1;
+        }
+        world.level = &level;
+    }
+
+    gameStatesInit();
+    if (runHeadlessMode && rollbackFrames > 0) {
+        simHistoryInit(&rollback, rollbackFrames);
+    }
+
+    if (exportPath != NULL) {
+        // the level setup() would stream for this seed
+        SetRandomSeed(seed);
+        setup();
+        int first = chunkIndexAt(CROWD_AREA.x);
+        int last = chunkIndexAt(CROWD_AREA.x + CROWD_AREA.width);
+        bool ok = levelExport(exportPath, world.seed, first, last - first + 1);
+        if (!ok) {
+            fprintf(stderr, "failed to write %s\n", exportPath);
+        }
+        gameStatesFree();
+        return ok ? 0 : 1;
+    }
+
+    // messages go to the log and are echoed by its writer thread, headless
+    // runs only keep a file when asked to
+    if (logPath == NULL && !runHeadlessMode) {
+        logPath = "leep-log.bin";
+    }
+    if (!binlogStart(logPath, true)) {
+        if (logPath != NULL) {
+            fprintf(stderr, "failed to create %s, not logging\n", logPath);
+        } else {
+            fprintf(stderr, "failed to start the log thread, not logging\n");
+        }
+    }
+
+    jobsInit(threads);
+
+    if (runHeadlessMode) {
+        int status = runHeadless(frames, seed);
+        jobsShutdown();
+        binlogStop();
+        allocReportLeaks();
+        return status;
+    }
+
     if (!init()) {
         fprintf(stderr, "Error during initalization\n");
     }
 
+    SetRandomSeed(seed);
     setup();
+    snapshotsInit(MAX_ENTITIES);
+    snapshotWrite(&snapshots[snapshotFront], 0, GetTime());
+
+    // The simulation of frame N + 1 runs on the pipeline thread while frame N
+    // is drawn from the front snapshot, which adds one frame of latency
+    if (pipelined && !pipelineStart(simFrame, &simRequest)) {
+        fprintf(stderr, "failed to start the pipeline thread, running"
+                        " serially\n");
+        pipelined = false;
+    }
 
+    InputFrame in;
+    inputFrameClear(&in);
+    double lastTime = GetTime();
     while (!WindowShouldClose()) {
+        pacerWait(&pacer);
+        double now = GetTime();
+        double frameTime = now - lastTime;
+        lastTime = now;
+
+        profileFrameBegin();
+        messagesMerge();
+        if (replaying) {
+            if (!replayNextFrame(&frameTime, &in)) {
+                break;
+            }
+        } else {
+            // on top of what the poll in EndDrawing() saw, the input that
+            // came in while the pacer slept
+            PollInputEvents();
+            inputPoll(&in, game->camera);
+        }
+        replayRecordFrame(frameTime, &in);
+
+        // the simulation is idle here, so commands can touch its state
+        handleCommands(&in);
+        simRequest = (SimRequest){in, frameTime, now};
+
         BeginDrawing();
-        update();
-        draw();
+        if (pipelined) {
+            pipelineKick();
+        } else {
+            profileBegin("simulate");
+            simFrame(&simRequest);
+            profileEnd();
+            snapshotSwap();
+        }
+
+        draw(&snapshots[snapshotFront]);
+
+        // includes the buffer swap and the VSync wait
+        profileBegin("EndDrawing");
+        pacerSubmit(&pacer);
         EndDrawing();
+        pacerPresented(&pacer);
+        profileEnd();
+
+        // the next PollInputEvents() resets the key queue and the pressed
+        // state, take what EndDrawing() polled into the next frame first
+        inputFrameClear(&in);
+        if (!replaying) {
+            inputPoll(&in, game->camera);
+        }
+
+        double latency = GetTime() - snapshots[snapshotFront].inputTime;
+        inputLatency += (latency - inputLatency) * 0.05;
+
+        if (pipelined) {
+            profileBegin("sim wait");
+            pipelineWait();
+            profileEnd();
+            snapshotSwap();
+        }
+        profileFrameEnd();
     }
 
+    // the pipeline is idle between frames, the state is final
+    int status = replayFinish();
     deInit();
+    return status;
 }
@@ -0,0 +1,225 @@
+#include "messages.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "binlog.h"
+#include "profile.h"
+#include "spsc.h"
+
+_Static_assert(BINLOG_MAX_THREADS >= MAX_MESSAGE_PRODUCERS + 1,
+               "every producer and the render thread get a log ring");
+
+typedef struct MessageQueue {
+    SpscRing ring;
+    char slots[MAX_MESSAGES_LEN][MAX_MESSAGE_LEN];
+} MessageQueue;
+
+static MessageQueue display = {.ring.capacity = MAX_MESSAGES_LEN};
+// when each display slot's message was put
+static uint64_t displayBirths[MAX_MESSAGES_LEN];
+static uint64_t displayVersion = 0;
+
+static MessageQueue producers[MAX_MESSAGE_PRODUCERS];
+static atomic_int producersLen = 0;
+static _Thread_local MessageQueue *producerQueue = NULL;
+// the thread asked for a queue and got none, it must not touch the display
+static _Thread_local bool producerRefused = false;
+
+static atomic_size_t dropped = 0;
+
+bool messagesRegisterProducer()
+{
+    if (producerQueue != NULL) {
+        return true;
+    }
+
+    int i = atomic_fetch_add(&producersLen, 1);
+    if (i >= MAX_MESSAGE_PRODUCERS) {
+        atomic_fetch_sub(&producersLen, 1);
+        producerRefused = true;
+        return false;
+    }
+
+    spscInit(&producers[i].ring, MAX_MESSAGES_LEN);
+    producerQueue = &producers[i];
+    return true;
+}
+
+// Claim the next slot of the calling thread's queue, NULL when it is full.
+// The display queue drops its oldest message instead since the render thread
+// owns both of its ends.
+static char *messagesReserve()
+{
+    size_t slot = 0;
+
+    if (producerRefused) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    if (producerQueue != NULL) {
+        if (!spscWriteSlot(&producerQueue->ring, &slot)) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+        return producerQueue->slots[slot];
+    }
+
+    if (!spscWriteSlot(&display.ring, &slot)) {
+        // remove first message
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        spscRelease(&display.ring);
+        spscWriteSlot(&display.ring, &slot);
+    }
+    displayBirths[slot] = profileNowNs();
+    return display.slots[slot];
+}
+
+static void messagesCommit()
+{
+    if (producerQueue != NULL) {
+        spscPublish(&producerQueue->ring);
+    } else {
+        spscPublish(&display.ring);
+        displayVersion += 1;
+    }
+}
+
+// a message already in the log
+static void messagesPutLogged(const char *m)
+{
+    char *slot = messagesReserve();
+    if (slot == NULL) {
+        return;
+    }
+
+    snprintf(slot, MAX_MESSAGE_LEN, "%s", m);
+    messagesCommit();
+}
+
+static void messagesLog(const char *fmt, ...)
+{
+    va_list argsp;
+    va_start(argsp, fmt);
+    binlogWrite(fmt, argsp);
+    va_end(argsp);
+}
+
+void messagesPut(const char *m)
+{
+    messagesLog("%s", m);
+    messagesPutLogged(m);
+}
+
+void messagesNew(const char *fmt, ...)
+{
+    va_list argsp;
+    va_start(argsp, fmt);
+    // logged even when the queue is full, the log only drops when its own
+    // ring is
+    binlogWrite(fmt, argsp);
+
+    char *slot = messagesReserve();
+    if (slot == NULL) {
+        va_end(argsp);
+        return;
+    }
+    vsnprintf(slot, MAX_MESSAGE_LEN, fmt, argsp);
+    va_end(argsp);
+
+    messagesCommit();
+}
+
+void messagesMerge()
+{
+    int len = atomic_load(&producersLen);
+    if (len > MAX_MESSAGE_PRODUCERS) {
+        len = MAX_MESSAGE_PRODUCERS;
+    }
+
+    for (int i = 0; i < len; i += 1) {
+        MessageQueue *q = &producers[i];
+        size_t slot;
+        while (spscReadSlot(&q->ring, &slot)) {
+            messagesPutLogged(q->slots[slot]);
+            spscRelease(&q->ring);
+        }
+    }
+}
+
+const char *messagesGet()
+{
+    size_t slot = 0;
+    if (!spscReadSlot(&display.ring, &slot)) {
+        return NULL;
+    }
+
+    spscRelease(&display.ring);
+    displayVersion += 1;
+    return display.slots[slot];
+}
+
+bool messagesIsEmpty() { return spscLen(&display.ring) == 0; }
+
+void messagesClear()
+{
+    size_t tail = atomic_load(&display.ring.tail);
+    atomic_store(&display.ring.head, tail);
+    displayVersion += 1;
+}
+
+size_t messagesCount() { return spscLen(&display.ring); }
+
+const char *messagesPeek(size_t i)
+{
+    if (i >= messagesCount()) {
+        return NULL;
+    }
+    return display.slots[spscPeekSlot(&display.ring, i)];
+}
+
+size_t messagesExpire(uint64_t maxAgeNs)
+{
+    uint64_t now = profileNowNs();
+    size_t expired = 0;
+
+    size_t slot = 0;
+    while (spscReadSlot(&display.ring, &slot) &&
+           now - displayBirths[slot] > maxAgeNs) {
+        spscRelease(&display.ring);
+        expired += 1;
+    }
+    if (expired > 0) {
+        displayVersion += 1;
+    }
+    return expired;
+}
+
+uint64_t messagesVersion() { return displayVersion; }
+
+size_t messagesDropped() { return atomic_load(&dropped); }
+
+void messagesDebug(bool printAllMemory)
+{
+    size_t head = atomic_load(&display.ring.head);
+    size_t len = messagesCount();
+
+    printf("messages = {\n");
+    printf("\t.index = %zu,\n", head % MAX_MESSAGES_LEN);
+    printf("\t.len = %zu,\n", len);
+    printf("\t.dropped = %zu,\n", messagesDropped());
+    printf("\t.data = {\n");
+    size_t stopIndex = printAllMemory ? MAX_MESSAGES_LEN : len;
+    for (size_t i = 0; i < stopIndex; i += 1) {
+        size_t messages_i = (head + i) % MAX_MESSAGES_LEN;
+        printf("\t\t");
+        if (i < len) {
+            printf("\"%s\",\n", display.slots[messages_i]);
+        } else {
+            printf("*\"%s\",\n", display.slots[messages_i]);
+        }
+    }
+    printf("\t}\n");
+    printf("}\n");
+}
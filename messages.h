@@ -0,0 +1,53 @@
+#ifndef MESSAGES_H
+#define MESSAGES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Message queue to display on screen
+//
+// The render thread owns the display queue. Any other thread has to call
+// messagesRegisterProducer() once, after which messagesNew() and
+// messagesPut() go to a single producer single consumer queue owned by that
+// thread. messagesMerge() moves those into the display queue on the render
+// thread. Putting never blocks or allocates, a message that does not fit is
+// counted in messagesDropped(). So is every message of a thread that found
+// no free producer queue, there is one for every job thread and the
+// pipeline thread.
+//
+// A string returned by messagesGet() or messagesPeek() stays valid until
+// MAX_MESSAGES_LEN more messages have been put.
+//
+// Every message in the display queue remembers when it entered it, so
+// messagesExpire() can drop the ones older than a given age. The display
+// queue's version changes whenever its contents do, anything derived from
+// it only has to be rebuilt when the version moved.
+//
+// Every message is also written to binlog.h, which prints it to stdout when
+// it was started with echo.
+#define MAX_MESSAGES_LEN 100
+#define MAX_MESSAGE_LEN 256
+#define MAX_MESSAGE_PRODUCERS 72
+
+bool messagesRegisterProducer();
+
+void messagesNew(const char *fmt, ...);
+void messagesPut(const char *m);
+
+// render thread only
+void messagesMerge();
+const char *messagesGet();
+bool messagesIsEmpty();
+void messagesClear();
+size_t messagesCount();
+const char *messagesPeek(size_t i);
+// drops the oldest messages that have been displayed for longer than maxAgeNs,
+// returns how many
+size_t messagesExpire(uint64_t maxAgeNs);
+uint64_t messagesVersion();
+
+size_t messagesDropped();
+void messagesDebug(bool printAllMemory);
+
+#endif
@@ -0,0 +1,116 @@
+#include "overlay.h"
+
+#include <raylib.h>
+
+#include "messages.h"
+
+size_t overlayLayout(OverlayLine *lines, int screenHeight, int fontSize,
+                     TextMeasureFn measure)
+{
+    size_t len = 0;
+    size_t messagesLen = messagesCount();
+    for (size_t i = 0; i < messagesLen && len < MAX_OVERLAY_LINES; i += 1) {
+        const char *text = messagesPeek(i);
+        if (text[0] == '\0') {
+            continue;
+        }
+
+        int textY = screenHeight -
+                    ((fontSize + OVERLAY_PADDING * 2 + 4) * (int)(i + 1)) - 10;
+        if (textY < fontSize) {
+            // every later message is even higher up
+            break;
+        }
+
+        lines[len] = (OverlayLine){
+            .text = text,
+            .x = 10,
+            .y = textY,
+            .width = measure(text, fontSize),
+        };
+        len += 1;
+    }
+    return len;
+}
+
+static const Color BOX_COLOR = {25, 25, 25, 39};
+
+static void drawLines(const OverlayLine *lines, size_t len, int fontSize,
+                      Color box, TextDrawFn draw)
+{
+    for (size_t i = 0; i < len; i += 1) {
+        const OverlayLine *l = &lines[i];
+        DrawRectangle(l->x - OVERLAY_PADDING, l->y - OVERLAY_PADDING,
+                      l->width + OVERLAY_PADDING * 2,
+                      fontSize + OVERLAY_PADDING * 2, box);
+        draw(l->text, l->x, l->y, fontSize, BLACK);
+    }
+}
+
+void overlayDraw(const OverlayLine *lines, size_t len, int fontSize)
+{
+    drawLines(lines, len, fontSize, BOX_COLOR, DrawText);
+}
+
+static void overlayCacheRender(OverlayCache *c, int fontSize,
+                               TextMeasureFn measure, TextDrawFn draw)
+{
+    static OverlayLine lines[MAX_OVERLAY_LINES];
+    size_t len = overlayLayout(lines, c->target.texture.height, fontSize,
+                               measure);
+
+    // The texture keeps premultiplied alpha, blending the translucent boxes
+    // as usual would multiply their alpha in twice. Black text is the same
+    // premultiplied or not.
+    Color box = {
+        BOX_COLOR.r * BOX_COLOR.a / 255,
+        BOX_COLOR.g * BOX_COLOR.a / 255,
+        BOX_COLOR.b * BOX_COLOR.a / 255,
+        BOX_COLOR.a,
+    };
+    BeginTextureMode(c->target);
+    ClearBackground(BLANK);
+    BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+    drawLines(lines, len, fontSize, box, draw);
+    EndBlendMode();
+    EndTextureMode();
+}
+
+void overlayCacheDraw(OverlayCache *c, int fontSize, TextMeasureFn measure,
+                      TextDrawFn draw)
+{
+    int width = GetScreenWidth();
+    int height = GetScreenHeight();
+    if (c->valid && (c->target.texture.width != width ||
+                     c->target.texture.height != height)) {
+        overlayCacheUnload(c);
+    }
+    bool stale = c->version != messagesVersion() || c->fontSize != fontSize;
+    if (!c->valid) {
+        c->target = LoadRenderTexture(width, height);
+        c->valid = true;
+        stale = true;
+    }
+
+    c->rendered = stale;
+    if (stale) {
+        overlayCacheRender(c, fontSize, measure, draw);
+        c->version = messagesVersion();
+        c->fontSize = fontSize;
+    }
+
+    // render textures are stored upside down
+    BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+    DrawTextureRec(c->target.texture,
+                   (Rectangle){0, 0, (float)width, (float)-height},
+                   (Vector2){0, 0}, WHITE);
+    EndBlendMode();
+}
+
+void overlayCacheUnload(OverlayCache *c)
+{
+    if (c->valid) {
+        UnloadRenderTexture(c->target);
+    }
+    *c = (OverlayCache){0};
+}
@@ -0,0 +1,54 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Layout of the message queue drawn in the bottom left corner of the screen,
+// newest message on top. Laying out does not touch the window so it can run
+// and be measured without one, measure is the HUD font's in the game.
+//
+// The game draws it through an OverlayCache, a screen sized RenderTexture
+// that is only laid out and rendered again when messagesVersion(), the font
+// size or the screen size changed.
+
+#define OVERLAY_PADDING 4
+#define MAX_OVERLAY_LINES 100
+
+typedef int (*TextMeasureFn)(const char *text, int fontSize);
+typedef void (*TextDrawFn)(const char *text, int x, int y, int fontSize,
+                           Color color);
+
+typedef struct OverlayLine {
+    const char *text;
+    int x;
+    int y;
+    int width;
+} OverlayLine;
+
+// lays out the queued messages that fit on screen into lines, returns how
+// many were written, at most MAX_OVERLAY_LINES
+size_t overlayLayout(OverlayLine *lines, int screenHeight, int fontSize,
+                     TextMeasureFn measure);
+// with DrawText()
+void overlayDraw(const OverlayLine *lines, size_t len, int fontSize);
+
+typedef struct OverlayCache {
+    RenderTexture2D target;
+    bool valid;
+    uint64_t version;
+    int fontSize;
+
+    // stats for the last draw
+    bool rendered;
+} OverlayCache;
+
+// draw the message overlay in the font of measure and draw, outside of
+// BeginMode2D
+void overlayCacheDraw(OverlayCache *c, int fontSize, TextMeasureFn measure,
+                      TextDrawFn draw);
+void overlayCacheUnload(OverlayCache *c);
+
+#endif
@@ -0,0 +1,124 @@
+#include "pacer.h"
+
+#include <raylib.h>
+#include <time.h>
+
+#include "profile.h"
+
+// the prediction falls back slowly, a single slow frame keeps the frame start
+// early for a while
+#define WORK_DECAY 0.02
+// margin for the buffer swap and the scheduler waking us up late
+#define MIN_SLACK_NS 1000000ull
+// the last part of a sleep spins, nanosleep often wakes up late by that much
+#define SPIN_NS 500000ull
+
+static void sleepUntil(uint64_t deadline)
+{
+    uint64_t now = profileNowNs();
+    if (deadline > now + SPIN_NS) {
+        uint64_t wake = deadline - SPIN_NS;
+        struct timespec ts = {
+            .tv_sec = wake / 1000000000,
+            .tv_nsec = wake % 1000000000,
+        };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    while (profileNowNs() < deadline) {
+    }
+}
+
+static void pacerRefresh(Pacer *p)
+{
+    int hz = GetMonitorRefreshRate(GetCurrentMonitor());
+    if (hz <= 0) {
+        hz = 60;
+    }
+    p->refreshHz = hz;
+    p->period = 1000000000ull / hz;
+}
+
+void pacerInit(Pacer *p)
+{
+    *p = (Pacer){0};
+    pacerRefresh(p);
+    p->presented = profileNowNs();
+    p->start = p->presented;
+}
+
+static uint64_t pacerSlack(const Pacer *p)
+{
+    uint64_t slack = p->period / 10;
+    return slack > MIN_SLACK_NS ? slack : MIN_SLACK_NS;
+}
+
+void pacerWait(Pacer *p)
+{
+    uint64_t budget = p->work + pacerSlack(p);
+    uint64_t vblank = p->presented + p->period;
+    if (budget < p->period) {
+        sleepUntil(vblank - budget);
+    }
+    p->start = profileNowNs();
+}
+
+void pacerSubmit(Pacer *p)
+{
+    uint64_t work = profileNowNs() - p->start;
+    if (work > p->work) {
+        p->work = work;
+    } else {
+        p->work -= (uint64_t)((p->work - work) * WORK_DECAY);
+    }
+}
+
+static void pacerWindowEnd(Pacer *p)
+{
+    if (p->windowMissed > PACER_MAX_MISSED) {
+        if (p->quality < PACER_MAX_QUALITY) {
+            p->quality += 1;
+        }
+        p->cleanWindows = 0;
+    } else if (p->windowMissed <= 1) {
+        p->cleanWindows += 1;
+        if (p->cleanWindows >= PACER_RECOVER_WINDOWS && p->quality > 0) {
+            p->quality -= 1;
+            p->cleanWindows = 0;
+        }
+    } else {
+        p->cleanWindows = 0;
+    }
+
+    p->missed = p->windowMissed;
+    p->windowMissed = 0;
+    p->windowFrames = 0;
+    // the window may have been moved to another monitor
+    pacerRefresh(p);
+}
+
+void pacerPresented(Pacer *p)
+{
+    uint64_t vblank = p->presented + p->period;
+    uint64_t now = profileNowNs();
+    // pacerWait() has the frame submitted about slack before the vblank, a
+    // swap that did not wait for VSync comes back right after that. The
+    // margin must stay below the slack or such a swap looks like it waited.
+    uint64_t early = pacerSlack(p) / 2;
+    if (now + early < vblank) {
+        sleepUntil(vblank);
+        now = vblank;
+    }
+
+    // a swap that waited comes back within jitter of the vblank
+    uint64_t jitter = p->period / 8;
+
+    if (now > vblank + jitter) {
+        p->windowMissed += 1;
+    }
+    p->presented = now;
+
+    p->windowFrames += 1;
+    if (p->windowFrames == PACER_WINDOW) {
+        pacerWindowEnd(p);
+    }
+}
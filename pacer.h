@@ -0,0 +1,49 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Frame pacing for the window
+//
+// Frames are presented with VSync at the refresh rate of the monitor the
+// window is on. Instead of starting the next frame as soon as one has been
+// presented, pacerWait() sleeps until the latest moment from which the
+// predicted work still makes the next vblank, so the input polled right after
+// it is as fresh as possible. When the driver does not block on VSync the
+// pacer sleeps until the vblank itself.
+//
+// Missed vblanks are counted over windows of PACER_WINDOW frames. A window
+// with more than PACER_MAX_MISSED of them lowers the quality by one level,
+// PACER_RECOVER_WINDOWS windows in a row with at most one raise it again.
+#define PACER_WINDOW 120
+#define PACER_MAX_MISSED (PACER_WINDOW / 10)
+#define PACER_RECOVER_WINDOWS 4
+// 0 is full quality, every level above it is cheaper to draw
+#define PACER_MAX_QUALITY 2
+
+typedef struct Pacer {
+    int refreshHz;
+    uint64_t period;
+    uint64_t presented; // when the last frame was presented
+    uint64_t start; // when the current frame started
+    uint64_t work; // predicted ns from the start of a frame to its submit
+
+    int quality;
+    int windowFrames;
+    int windowMissed;
+    int cleanWindows;
+    // stats for the last finished window
+    int missed;
+} Pacer;
+
+// call after InitWindow(), picks up the refresh rate of the window's monitor
+void pacerInit(Pacer *p);
+// sleeps until the frame should start, call before polling its input
+void pacerWait(Pacer *p);
+// call right before EndDrawing()
+void pacerSubmit(Pacer *p);
+// call right after EndDrawing()
+void pacerPresented(Pacer *p);
+
+#endif
@@ -0,0 +1,96 @@
+#include "pipeline.h"
+
+#include <assert.h>
+#include <pthread.h>
+
+#include "jobs.h"
+#include "messages.h"
+
+static pthread_t thread;
+static bool running = false;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static bool kicked = false;
+static bool stopping = false;
+
+static PipelineFn pipelineFn = NULL;
+static void *pipelineData = NULL;
+
+static void *pipelineMain(void *arg)
+{
+    (void)arg;
+    // without a queue the simulation's messages are dropped
+    bool registered = messagesRegisterProducer();
+    assert(registered);
+    (void)registered;
+    // jobsInit() leaves a deque for this thread, without it the simulation
+    // just runs its jobs inline
+    bool attached = jobsAttachThread();
+    assert(attached);
+    (void)attached;
+
+    pthread_mutex_lock(&lock);
+    while (true) {
+        while (!kicked && !stopping) {
+            pthread_cond_wait(&cond, &lock);
+        }
+        if (stopping) {
+            break;
+        }
+
+        pthread_mutex_unlock(&lock);
+        pipelineFn(pipelineData);
+        pthread_mutex_lock(&lock);
+
+        kicked = false;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+bool pipelineStart(PipelineFn fn, void *data)
+{
+    pipelineFn = fn;
+    pipelineData = data;
+    kicked = false;
+    stopping = false;
+
+    running = pthread_create(&thread, NULL, pipelineMain, NULL) == 0;
+    return running;
+}
+
+void pipelineStop()
+{
+    if (!running) {
+        return;
+    }
+
+    pipelineWait();
+
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+
+    pthread_join(thread, NULL);
+    running = false;
+}
+
+void pipelineKick()
+{
+    pthread_mutex_lock(&lock);
+    kicked = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+void pipelineWait()
+{
+    pthread_mutex_lock(&lock);
+    while (kicked) {
+        pthread_cond_wait(&cond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
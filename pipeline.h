@@ -0,0 +1,21 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+
+// A thread that runs one function per kick, so the caller can overlap its own
+// work with it.
+//
+// pipelineKick() starts a run and returns immediately, pipelineWait() blocks
+// until that run finished and makes its writes visible. Only one run is in
+// flight at a time. The thread is registered as a message producer and
+// attached to the job system so fn can use both.
+typedef void (*PipelineFn)(void *data);
+
+bool pipelineStart(PipelineFn fn, void *data);
+void pipelineStop();
+
+void pipelineKick();
+void pipelineWait();
+
+#endif
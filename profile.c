@@ -0,0 +1,233 @@
+#include "profile.h"
+
+#include <raylib.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef struct ProfileScope {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+    int depth;
+} ProfileScope;
+
+typedef struct ProfileFrame {
+    uint64_t start;
+    uint64_t end;
+    size_t scopesLen;
+    ProfileScope scopes[PROFILE_MAX_SCOPES];
+} ProfileFrame;
+
+static ProfileFrame frames[PROFILE_FRAMES] = {0};
+static size_t framesIndex = 0; // frame currently being recorded
+static size_t framesLen = 0;   // finished frames in the window
+
+// indices into the current frame of the scopes that are still open, scopes
+// that did not fit are counted in openScopesLen but not recorded
+static size_t openScopes[PROFILE_MAX_SCOPES];
+static int openScopesLen = 0;
+
+uint64_t profileNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void profileFrameBegin()
+{
+    ProfileFrame *f = &frames[framesIndex];
+    f->start = profileNowNs();
+    f->end = 0;
+    f->scopesLen = 0;
+    openScopesLen = 0;
+}
+
+void profileFrameEnd()
+{
+    // close anything left open so the trace stays well formed
+    while (openScopesLen > 0) {
+        profileEnd();
+    }
+
+    frames[framesIndex].end = profileNowNs();
+
+    framesIndex = (framesIndex + 1) % PROFILE_FRAMES;
+    if (framesLen < PROFILE_FRAMES - 1) {
+        framesLen += 1;
+    }
+}
+
+void profileBegin(const char *name)
+{
+    ProfileFrame *f = &frames[framesIndex];
+    if (openScopesLen >= PROFILE_MAX_SCOPES) {
+        openScopesLen += 1;
+        return;
+    }
+    if (f->scopesLen >= PROFILE_MAX_SCOPES) {
+        openScopes[openScopesLen++] = SIZE_MAX;
+        return;
+    }
+
+    f->scopes[f->scopesLen] = (ProfileScope){
+        .name = name,
+        .start = profileNowNs(),
+        .depth = openScopesLen,
+    };
+    openScopes[openScopesLen++] = f->scopesLen;
+    f->scopesLen += 1;
+}
+
+void profileEnd()
+{
+    if (openScopesLen == 0) {
+        return;
+    }
+
+    openScopesLen -= 1;
+    if (openScopesLen >= PROFILE_MAX_SCOPES) {
+        return;
+    }
+
+    size_t i = openScopes[openScopesLen];
+    if (i != SIZE_MAX) {
+        frames[framesIndex].scopes[i].end = profileNowNs();
+    }
+}
+
+// i = 0 is the oldest finished frame
+static const ProfileFrame *finishedFrame(size_t i)
+{
+    size_t oldest = (framesIndex + PROFILE_FRAMES - framesLen) % PROFILE_FRAMES;
+    return &frames[(oldest + i) % PROFILE_FRAMES];
+}
+
+uint64_t profileLastFrameNs()
+{
+    if (framesLen == 0) {
+        return 0;
+    }
+
+    const ProfileFrame *f = finishedFrame(framesLen - 1);
+    return f->end - f->start;
+}
+
+static Color scopeColor(const char *name)
+{
+    const Color PALETTE[] = {ORANGE, SKYBLUE, LIME,  VIOLET,
+                             GOLD,   PINK,    BEIGE, MAROON};
+
+    // names are literals so the pointer is a stable key
+    uintptr_t h = (uintptr_t)name;
+    h ^= h >> 7;
+    return PALETTE[h % (sizeof(PALETTE) / sizeof(*PALETTE))];
+}
+
+void profileDrawGraph(int x, int y, int width, int height)
+{
+    // full graph height is two 60Hz frames
+    const double SCALE_NS = 2 * 1e9 / 60;
+    const int FONT_SIZE = 10;
+
+    DrawRectangle(x, y, width, height, (Color){0, 0, 0, 160});
+
+    size_t count = framesLen < (size_t)width ? framesLen : (size_t)width;
+    uint64_t worstNs = 0;
+
+    for (size_t i = 0; i < count; i += 1) {
+        const ProfileFrame *f = finishedFrame(framesLen - count + i);
+        int barX = x + width - (int)count + (int)i;
+
+        uint64_t frameNs = f->end - f->start;
+        if (frameNs > worstNs) {
+            worstNs = frameNs;
+        }
+
+        int frameH = (int)(frameNs / SCALE_NS * height);
+        if (frameH > height) {
+            frameH = height;
+        }
+        DrawLine(barX, y + height, barX, y + height - frameH, GRAY);
+
+        // stack the top level scopes on top of the unscoped frame time
+        int stackH = 0;
+        for (size_t s = 0; s < f->scopesLen; s += 1) {
+            const ProfileScope *scope = &f->scopes[s];
+            if (scope->depth != 0 || scope->end < scope->start) {
+                continue;
+            }
+
+            int h = (int)((scope->end - scope->start) / SCALE_NS * height);
+            if (stackH + h > height) {
+                h = height - stackH;
+            }
+            DrawLine(barX, y + height - stackH, barX, y + height - stackH - h,
+                     scopeColor(scope->name));
+            stackH += h;
+        }
+    }
+
+    // 60Hz and 120Hz budgets
+    DrawLine(x, y + height / 2, x + width, y + height / 2, RED);
+    DrawLine(x, y + height * 3 / 4, x + width, y + height * 3 / 4, YELLOW);
+
+    DrawText(TextFormat("%.2f ms (worst %.2f ms) %i fps",
+                        profileLastFrameNs() / 1e6, worstNs / 1e6, GetFPS()),
+             x + 4, y + 4, FONT_SIZE, WHITE);
+
+    // legend from the scopes of the last frame
+    if (framesLen > 0) {
+        const ProfileFrame *f = finishedFrame(framesLen - 1);
+        int legendY = y + 4 + FONT_SIZE + 2;
+        for (size_t s = 0; s < f->scopesLen; s += 1) {
+            const ProfileScope *scope = &f->scopes[s];
+            if (scope->depth != 0) {
+                continue;
+            }
+            DrawText(TextFormat("%s %.2f ms", scope->name,
+                                (scope->end - scope->start) / 1e6),
+                     x + 4, legendY, FONT_SIZE, scopeColor(scope->name));
+            legendY += FONT_SIZE + 2;
+        }
+    }
+}
+
+bool profileDumpTrace(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return false;
+    }
+
+    uint64_t origin = framesLen > 0 ? finishedFrame(0)->start : 0;
+    bool first = true;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < framesLen; i += 1) {
+        const ProfileFrame *frame = finishedFrame(i);
+
+        fprintf(f,
+                "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", (frame->start - origin) / 1e3,
+                (frame->end - frame->start) / 1e3);
+        first = false;
+
+        for (size_t s = 0; s < frame->scopesLen; s += 1) {
+            const ProfileScope *scope = &frame->scopes[s];
+            if (scope->end < scope->start) {
+                continue;
+            }
+
+            fprintf(f,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    scope->name, (scope->start - origin) / 1e3,
+                    (scope->end - scope->start) / 1e3);
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    return fclose(f) == 0;
+}
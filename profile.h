@@ -0,0 +1,33 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Frame profiler
+//
+// Scopes are recorded per frame into a rolling window of the last
+// PROFILE_FRAMES frames. The window is drawn as a frame time graph and can be
+// dumped as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Scopes nest and are only recorded from the main thread, names must be
+// string literals since only the pointer is stored.
+
+#define PROFILE_FRAMES 300
+#define PROFILE_MAX_SCOPES 32
+
+uint64_t profileNowNs();
+
+void profileFrameBegin();
+void profileFrameEnd();
+
+void profileBegin(const char *name);
+void profileEnd();
+
+// duration of the last finished frame
+uint64_t profileLastFrameNs();
+
+void profileDrawGraph(int x, int y, int width, int height);
+bool profileDumpTrace(const char *path);
+
+#endif
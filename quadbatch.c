@@ -0,0 +1,118 @@
+#include "quadbatch.h"
+
+#include <assert.h>
+#include <raymath.h>
+#include <rlgl.h>
+#include <stddef.h>
+
+#include "alloc.h"
+
+#define VERTICES_PER_QUAD 6
+
+void quadBatchInit(QuadBatch *b, int capacity)
+{
+    *b = (QuadBatch){
+        .positions = allocMem(ALLOC_RENDER, capacity * VERTICES_PER_QUAD * 2 *
+                                                sizeof(float)),
+        .colors = allocMem(ALLOC_RENDER,
+                           capacity * VERTICES_PER_QUAD * sizeof(Color)),
+        .capacity = capacity,
+    };
+}
+
+void quadBatchAdd(QuadBatch *b, Rectangle r, Color color)
+{
+    assert(b->positions != NULL && "quad batch was already uploaded");
+    assert(b->len < b->capacity);
+
+    // same winding as DrawRectangleRec so backface culling keeps them
+    const float corners[VERTICES_PER_QUAD][2] = {
+        {r.x, r.y},                      // top left
+        {r.x, r.y + r.height},           // bottom left
+        {r.x + r.width, r.y + r.height}, // bottom right
+        {r.x, r.y},                      // top left
+        {r.x + r.width, r.y + r.height}, // bottom right
+        {r.x + r.width, r.y},            // top right
+    };
+
+    float *pos = &b->positions[b->len * VERTICES_PER_QUAD * 2];
+    Color *col = &b->colors[b->len * VERTICES_PER_QUAD];
+    for (int v = 0; v < VERTICES_PER_QUAD; v += 1) {
+        pos[v * 2 + 0] = corners[v][0];
+        pos[v * 2 + 1] = corners[v][1];
+        col[v] = color;
+    }
+
+    b->len += 1;
+}
+
+void quadBatchUpload(QuadBatch *b)
+{
+    int vertices = b->len * VERTICES_PER_QUAD;
+
+    b->vao = rlLoadVertexArray();
+    rlEnableVertexArray(b->vao);
+
+    b->positionsVbo = rlLoadVertexBuffer(
+        b->positions, vertices * 2 * sizeof(float), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2,
+                         RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+
+    b->colorsVbo =
+        rlLoadVertexBuffer(b->colors, vertices * sizeof(Color), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4,
+                         RL_UNSIGNED_BYTE, true, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+
+    rlDisableVertexArray();
+
+    allocFree(b->positions);
+    allocFree(b->colors);
+    b->positions = NULL;
+    b->colors = NULL;
+}
+
+void quadBatchUnload(QuadBatch *b)
+{
+    if (b->vao != 0) {
+        rlUnloadVertexArray(b->vao);
+        rlUnloadVertexBuffer(b->positionsVbo);
+        rlUnloadVertexBuffer(b->colorsVbo);
+    }
+    allocFree(b->positions);
+    allocFree(b->colors);
+
+    *b = (QuadBatch){0};
+}
+
+void quadBatchDraw(const QuadBatch *b, int first, int count)
+{
+    if (b->vao == 0 || count <= 0) {
+        return;
+    }
+    assert(first >= 0 && first + count <= b->len);
+
+    // flush what was drawn before us so the draw order is kept
+    rlDrawRenderBatchActive();
+
+    Matrix mvp =
+        MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+    const float tint[4] = {1, 1, 1, 1};
+    int *locs = rlGetShaderLocsDefault();
+
+    rlEnableShader(rlGetShaderIdDefault());
+    rlSetUniformMatrix(locs[SHADER_LOC_MATRIX_MVP], mvp);
+    rlSetUniform(locs[SHADER_LOC_COLOR_DIFFUSE], tint, SHADER_UNIFORM_VEC4, 1);
+
+    // the default shader samples texture0, bind the 1x1 white texture
+    rlActiveTextureSlot(0);
+    rlEnableTexture(rlGetTextureIdDefault());
+
+    rlEnableVertexArray(b->vao);
+    rlDrawVertexArray(first * VERTICES_PER_QUAD, count * VERTICES_PER_QUAD);
+    rlDisableVertexArray();
+
+    rlDisableTexture();
+    rlDisableShader();
+}
@@ -0,0 +1,31 @@
+#ifndef QUADBATCH_H
+#define QUADBATCH_H
+
+#include <raylib.h>
+
+// Static colored rectangles uploaded once into a vertex buffer and drawn with
+// a single draw call through raylib's default shader.
+//
+// Fill with quadBatchAdd() then quadBatchUpload(), the CPU copy is released
+// on upload. Quads keep the order they were added in so a contiguous range
+// can be drawn with quadBatchDraw().
+typedef struct QuadBatch {
+    float *positions; // 6 vertices * xy per quad
+    Color *colors;    // 6 per quad
+    int len;
+    int capacity;
+
+    unsigned int vao;
+    unsigned int positionsVbo;
+    unsigned int colorsVbo;
+} QuadBatch;
+
+void quadBatchInit(QuadBatch *b, int capacity);
+void quadBatchAdd(QuadBatch *b, Rectangle rect, Color color);
+void quadBatchUpload(QuadBatch *b);
+void quadBatchUnload(QuadBatch *b);
+
+// Draw quads [first, first + count) under the current 2D transform
+void quadBatchDraw(const QuadBatch *b, int first, int count);
+
+#endif
@@ -0,0 +1,157 @@
+#include "replay.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char MAGIC[4] = {'L', 'E', 'E', 'P'};
+#define FOOTER_TAG 0xff
+
+static FILE *recording = NULL;
+static bool recordingFailed = false;
+static uint32_t recordedFrames = 0;
+
+static FILE *replaying = NULL;
+static bool replayEnded = false;
+static bool footerFound = false;
+static uint32_t replayedFrames = 0;
+
+static void put(const void *data, size_t size)
+{
+    if (fwrite(data, size, 1, recording) != 1) {
+        recordingFailed = true;
+    }
+}
+
+static bool get(void *data, size_t size)
+{
+    return fread(data, size, 1, replaying) == 1;
+}
+
+bool replayRecordBegin(const char *path, ReplayInfo info)
+{
+    recording = fopen(path, "wb");
+    if (recording == NULL) {
+        return false;
+    }
+    recordingFailed = false;
+    recordedFrames = 0;
+
+    uint32_t version = REPLAY_VERSION;
+    put(MAGIC, sizeof(MAGIC));
+    put(&version, sizeof(version));
+    put(&info.seed, sizeof(info.seed));
+    put(&info.agents, sizeof(info.agents));
+    return !recordingFailed;
+}
+
+void replayRecordFrame(double frameTime, const InputFrame *in)
+{
+    if (recording == NULL) {
+        return;
+    }
+
+    uint8_t len = (uint8_t)in->len;
+    put(&len, sizeof(len));
+    put(&frameTime, sizeof(frameTime));
+    for (int i = 0; i < in->len; i += 1) {
+        const InputEvent *e = &in->events[i];
+        put(&e->type, sizeof(e->type));
+        put(&e->code, sizeof(e->code));
+        put(&e->pos.x, sizeof(e->pos.x));
+        put(&e->pos.y, sizeof(e->pos.y));
+    }
+    recordedFrames += 1;
+}
+
+bool replayRecordEnd(ReplayResult result)
+{
+    if (recording == NULL) {
+        return false;
+    }
+
+    uint8_t tag = FOOTER_TAG;
+    put(&tag, sizeof(tag));
+    put(&recordedFrames, sizeof(recordedFrames));
+    put(&result.stateHash, sizeof(result.stateHash));
+    put(result.state, sizeof(result.state));
+
+    bool ok = fclose(recording) == 0 && !recordingFailed;
+    recording = NULL;
+    return ok;
+}
+
+bool replayOpen(const char *path, ReplayInfo *info)
+{
+    replaying = fopen(path, "rb");
+    if (replaying == NULL) {
+        return false;
+    }
+    replayEnded = false;
+    footerFound = false;
+    replayedFrames = 0;
+
+    char magic[4];
+    uint32_t version;
+    if (!get(magic, sizeof(magic)) || memcmp(magic, MAGIC, 4) != 0 ||
+        !get(&version, sizeof(version)) || version != REPLAY_VERSION ||
+        !get(&info->seed, sizeof(info->seed)) ||
+        !get(&info->agents, sizeof(info->agents))) {
+        fclose(replaying);
+        replaying = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool replayNextFrame(double *frameTime, InputFrame *in)
+{
+    if (replaying == NULL || replayEnded) {
+        return false;
+    }
+
+    inputFrameClear(in);
+
+    // a truncated file just ends the replay, replayClose() reports it
+    uint8_t len = 0;
+    if (!get(&len, sizeof(len)) || len == FOOTER_TAG) {
+        footerFound = len == FOOTER_TAG;
+        replayEnded = true;
+        return false;
+    }
+    if (len > MAX_INPUT_EVENTS || !get(frameTime, sizeof(*frameTime))) {
+        replayEnded = true;
+        return false;
+    }
+
+    for (int i = 0; i < len; i += 1) {
+        InputEvent e = {0};
+        if (!get(&e.type, sizeof(e.type)) || !get(&e.code, sizeof(e.code)) ||
+            !get(&e.pos.x, sizeof(e.pos.x)) ||
+            !get(&e.pos.y, sizeof(e.pos.y))) {
+            replayEnded = true;
+            return false;
+        }
+        inputFramePush(in, e);
+    }
+    replayedFrames += 1;
+    return true;
+}
+
+uint32_t replayFramesPlayed() { return replayedFrames; }
+
+bool replayClose(ReplayResult *expected)
+{
+    if (replaying == NULL) {
+        return false;
+    }
+
+    bool ok = footerFound &&
+              get(&expected->frames, sizeof(expected->frames)) &&
+              get(&expected->stateHash, sizeof(expected->stateHash)) &&
+              get(expected->state, sizeof(expected->state)) &&
+              fgetc(replaying) == EOF;
+
+    fclose(replaying);
+    replaying = NULL;
+    return ok;
+}
@@ -0,0 +1,51 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "input.h"
+
+// Input recordings
+//
+// A recording is everything the simulation is fed: the random seed setup()
+// draws the level from, the crowd size and for every frame its frame time
+// and input events. Feeding it back through update() and simulate()
+// reproduces the run exactly, which the footer checks by storing the state
+// hash and the player at the end.
+//
+// Layout, native byte order:
+//   header   "LEEP" u32 version u32 seed u32 agents
+//   frame    u8 eventCount f64 frameTime, eventCount times
+//            u8 type i16 code f32 x f32 y
+//   footer   u8 0xff u32 frames u32 stateHash f32 pos.x pos.y vel.x vel.y
+
+// 2: R restores the state setup() made instead of running it again
+#define REPLAY_VERSION 2
+
+typedef struct ReplayInfo {
+    uint32_t seed;
+    uint32_t agents;
+} ReplayInfo;
+
+typedef struct ReplayResult {
+    uint32_t frames;
+    uint32_t stateHash;
+    float state[4]; // player pos and vel
+} ReplayResult;
+
+bool replayRecordBegin(const char *path, ReplayInfo info);
+void replayRecordFrame(double frameTime, const InputFrame *in);
+// writes the footer and closes the file, false if any write failed
+bool replayRecordEnd(ReplayResult result);
+
+bool replayOpen(const char *path, ReplayInfo *info);
+// false once the recording is exhausted, the footer can then be read
+bool replayNextFrame(double *frameTime, InputFrame *in);
+// frames replayNextFrame() returned since replayOpen()
+uint32_t replayFramesPlayed();
+// the recorded result, false when the file ended without a footer or goes on
+// after it
+bool replayClose(ReplayResult *expected);
+
+#endif
@@ -0,0 +1,264 @@
+#include "sim.h"
+
+#include <assert.h>
+#include <math.h>
+#include <raymath.h>
+
+#include "alloc.h"
+#include "hash.h"
+#include "jobs.h"
+
+const float GRAVITY = 0.3;
+
+// entities per job, small enough to spread a crowd over all cores and large
+// enough to keep the SIMD loops busy
+#define ENTITY_CHUNK 1024
+
+typedef struct CrowdJob {
+    EntityStore *entities;
+    size_t frame;
+} CrowdJob;
+
+// Crowd agents pick a new heading every two seconds and coast to a stop in
+// between, the headings are hashed from the frame so there is no generator
+// to keep
+static void crowdThink(void *data, size_t begin, size_t end)
+{
+    const CrowdJob *job = data;
+    EntityStore *entities = job->entities;
+    size_t frame = job->frame;
+
+    // the player is entity 0
+    for (size_t i = begin > 0 ? begin : 1; i < end; i += 1) {
+        size_t phase = (frame + i * 7) % 120;
+        if (phase == 0) {
+            float angle = hash32(frame * 31 + i) / (float)UINT32_MAX * 2 * PI;
+            playersMove(entities, i,
+                        Vector2Scale((Vector2){cosf(angle), sinf(angle)},
+                                     entities->maxVel[i]));
+        } else if (phase > 60) {
+            playersStop(entities, i);
+        }
+    }
+}
+
+static void crowdUpdate(EntityStore *entities, size_t frame)
+{
+    CrowdJob job = {entities, frame};
+    jobsParallelFor(entities->len, ENTITY_CHUNK, crowdThink, &job);
+}
+
+// W/A/S/D and the left mouse button keep the player moving while held, it
+// only stops once all of them are released
+#define MOVE_MOUSE (1u << 4)
+
+static unsigned moveBit(const InputEvent *e)
+{
+    if (e->type == INPUT_MOUSE_DOWN || e->type == INPUT_MOUSE_UP) {
+        return e->code == MOUSE_BUTTON_LEFT ? MOVE_MOUSE : 0;
+    }
+    switch (e->code) {
+    case KEY_W:
+        return 1u << 0;
+    case KEY_A:
+        return 1u << 1;
+    case KEY_S:
+        return 1u << 2;
+    case KEY_D:
+        return 1u << 3;
+    }
+    return 0;
+}
+
+static void playerSteer(GameState *s, EntityStore *entities, Vector2 target)
+{
+    s->directionVector = Vector2Subtract(target, entities->pos[PLAYER]);
+    playersMove(entities, PLAYER, s->directionVector);
+}
+
+static void playerKeyDown(EntityStore *entities, int key)
+{
+    switch (key) {
+    case KEY_UP:
+        entities->pos[PLAYER].y -= 10;
+        break;
+    case KEY_LEFT:
+        entities->pos[PLAYER].x -= 10;
+        break;
+    case KEY_DOWN:
+        entities->pos[PLAYER].y += 10;
+        break;
+    case KEY_RIGHT:
+        entities->pos[PLAYER].x += 10;
+        break;
+    case KEY_W:
+        playersMove(entities, PLAYER, (Vector2){0, -10});
+        break;
+    case KEY_A:
+        playersMove(entities, PLAYER, (Vector2){-10, 0});
+        break;
+    case KEY_S:
+        playersMove(entities, PLAYER, (Vector2){0, 10});
+        break;
+    case KEY_D:
+        playersMove(entities, PLAYER, (Vector2){10, 0});
+        break;
+    }
+}
+
+static void update(GameState *s, EntityStore *entities, const InputFrame *in)
+{
+    s->frame += 1;
+
+    for (int i = 0; i < in->len; i += 1) {
+        const InputEvent *e = &in->events[i];
+
+        switch (e->type) {
+        case INPUT_KEY_DOWN:
+            playerKeyDown(entities, e->code);
+            break;
+        case INPUT_MOUSE_DOWN:
+            if (e->code == MOUSE_BUTTON_LEFT) {
+                playerSteer(s, entities, e->pos);
+            }
+            break;
+        case INPUT_MOUSE_MOVE:
+            if (s->moveHeld & MOVE_MOUSE) {
+                playerSteer(s, entities, e->pos);
+            }
+            break;
+        }
+
+        unsigned bit = moveBit(e);
+        if (e->type == INPUT_KEY_DOWN || e->type == INPUT_MOUSE_DOWN) {
+            s->moveHeld |= bit;
+            s->stopPending = s->stopPending && bit == 0;
+        } else if ((s->moveHeld & bit) != 0) {
+            s->moveHeld &= ~bit;
+            s->stopPending = s->moveHeld == 0;
+        }
+    }
+
+    // a stop is ignored while the velocity is still transitioning, so it is
+    // retried every frame until it sticks
+    if (s->stopPending) {
+        s->stopPending = !playersStop(entities, PLAYER);
+    }
+
+    crowdUpdate(entities, s->frame);
+}
+
+// One fixed simulation step
+static void stepChunk(void *data, size_t begin, size_t end)
+{
+    playersUpdateRange(data, begin, end - begin);
+}
+
+static void step(EntityStore *entities, Collider *c)
+{
+    // playerVel.y += GRAVITY;
+    jobsParallelFor(entities->len, ENTITY_CHUNK, stepChunk, entities);
+
+    // the crowd walks through walls, only the player collides
+    Vector2 from = entities->prevPos[PLAYER];
+    Vector2 motion = Vector2Subtract(entities->pos[PLAYER], from);
+    entities->pos[PLAYER] =
+        collideMove(c, from, motion, entities->radius[PLAYER],
+                    &entities->vel[PLAYER]);
+}
+
+// Apply the input, then run as many fixed steps as fit into the elapsed time
+float simulate(GameState *s, Collider *c, const InputFrame *in,
+               double frameTime)
+{
+    EntityStore entities;
+    gameStateBind(s, &entities);
+
+    update(s, &entities, in);
+
+    s->accumulator += frameTime;
+
+    int steps = 0;
+    while (s->accumulator >= SIM_DT && steps < SIM_MAX_STEPS) {
+        step(&entities, c);
+        s->accumulator -= SIM_DT;
+        steps += 1;
+    }
+
+    if (s->accumulator >= SIM_DT) {
+        // fell too far behind, drop the backlog instead of spiraling
+        s->accumulator = fmod(s->accumulator, SIM_DT);
+    }
+
+    return s->accumulator / SIM_DT;
+}
+
+void simHistoryInit(SimHistory *h, size_t capacity)
+{
+    *h = (SimHistory){
+        .states = allocMem(ALLOC_ENTITIES, capacity * sizeof(*h->states)),
+        .inputs = allocMem(ALLOC_OTHER, capacity * sizeof(*h->inputs)),
+        .capacity = capacity,
+    };
+}
+
+void simHistoryFree(SimHistory *h)
+{
+    allocFree(h->states);
+    allocFree(h->inputs);
+    *h = (SimHistory){0};
+}
+
+void simHistoryClear(SimHistory *h)
+{
+    h->len = 0;
+    h->next = 0;
+}
+
+void simHistoryPush(SimHistory *h, const GameState *s, const InputFrame *in,
+                    double frameTime)
+{
+    if (h->capacity == 0) {
+        return;
+    }
+
+    gameStateCopy(&h->states[h->next], s);
+    h->inputs[h->next] = (SimInput){*in, frameTime};
+    h->next = (h->next + 1) % h->capacity;
+    if (h->len < h->capacity) {
+        h->len += 1;
+    }
+}
+
+// slot of the frame ago frames back
+static size_t historySlot(const SimHistory *h, size_t ago)
+{
+    return (h->next + h->capacity - ago) % h->capacity;
+}
+
+SimInput *simHistoryInput(SimHistory *h, size_t ago)
+{
+    assert(ago > 0 && ago <= h->len);
+    return &h->inputs[historySlot(h, ago)];
+}
+
+float simResimulate(SimHistory *h, GameState *s, Collider *c, size_t frames)
+{
+    assert(frames > 0 && frames <= h->len);
+
+    // the oldest state is all that is read, the later ones are rewritten
+    // with what the corrected inputs lead to
+    size_t slot = historySlot(h, frames);
+    gameStateCopy(s, &h->states[slot]);
+
+    float alpha = 0;
+    for (size_t i = 0; i < frames; i += 1) {
+        if (i > 0) {
+            gameStateCopy(&h->states[slot], s);
+        }
+        const SimInput *input = &h->inputs[slot];
+        alpha = simulate(s, c, &input->in, input->frameTime);
+        slot = (slot + 1) % h->capacity;
+    }
+    return alpha;
+}
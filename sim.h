@@ -0,0 +1,60 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "collide.h"
+#include "gamestate.h"
+#include "input.h"
+
+// The simulation as a pure function of the game state and its input
+//
+// simulate() reads nothing but the state, the frame's input events and frame
+// time, and the collider, whose results do not depend on what it has cached.
+// It draws no random numbers from a global generator and posts no messages,
+// so feeding the same inputs to the same state gives the same state on any
+// thread and any number of times, which is what rolling back relies on.
+//
+// A SimHistory remembers the last frames' inputs and the states they started
+// from. When the input of one of them turns out to be wrong it is corrected
+// in place and simResimulate() runs the frames from there again.
+#define SIM_DT (1.0 / SIM_HZ)
+// after a stall only this many steps are run, the rest of the backlog is
+// dropped
+#define SIM_MAX_STEPS 8
+
+// advance s by one frame, returns how far it is into the next fixed step,
+// used to interpolate the rendered state
+float simulate(GameState *s, Collider *c, const InputFrame *in,
+               double frameTime);
+
+typedef struct SimInput {
+    InputFrame in;
+    double frameTime;
+} SimInput;
+
+typedef struct SimHistory {
+    GameState *states; // before each remembered frame
+    SimInput *inputs;
+    size_t capacity;
+    size_t len;  // frames remembered, at most capacity
+    size_t next; // slot the next frame goes to
+} SimHistory;
+
+void simHistoryInit(SimHistory *h, size_t capacity);
+void simHistoryFree(SimHistory *h);
+// forget every frame, for when the state is replaced by something else
+void simHistoryClear(SimHistory *h);
+// remember s before it is fed in and frameTime
+void simHistoryPush(SimHistory *h, const GameState *s, const InputFrame *in,
+                    double frameTime);
+// the input of the frame ago frames back, 1 is the newest
+SimInput *simHistoryInput(SimHistory *h, size_t ago);
+
+// Roll s back by frames frames and simulate them again with the inputs in the
+// history, rewriting the states they started from. s ends up where the
+// history ends, returns the last simulate()'s result.
+float simResimulate(SimHistory *h, GameState *s, Collider *c, size_t frames);
+
+#endif
@@ -0,0 +1,69 @@
+#include "spatial.h"
+
+#include <assert.h>
+
+void spatialIndexBuild(SpatialIndex *idx, const Rectangle *rects, int len)
+{
+    spatialIndexBuildStrided(idx, rects, sizeof(Rectangle), len);
+}
+
+void spatialIndexBuildStrided(SpatialIndex *idx, const Rectangle *first,
+                              size_t stride, int len)
+{
+    *idx = (SpatialIndex){
+        .rects = (const char *)first,
+        .stride = stride,
+        .len = len,
+    };
+
+    for (int i = 0; i < len; i += 1) {
+        const Rectangle *r = spatialIndexRect(idx, i);
+        assert((i == 0 || spatialIndexRect(idx, i - 1)->x <= r->x) &&
+               "spatial index input must be sorted by x");
+        if (r->width > idx->maxWidth) {
+            idx->maxWidth = r->width;
+        }
+    }
+}
+
+const Rectangle *spatialIndexRect(const SpatialIndex *idx, int i)
+{
+    return (const Rectangle *)(idx->rects + (size_t)i * idx->stride);
+}
+
+// first index whose x is >= (or > when strict) the given x
+static int lowerBound(const SpatialIndex *idx, float x, bool strict)
+{
+    int lo = 0;
+    int hi = idx->len;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        float midX = spatialIndexRect(idx, mid)->x;
+        if (midX < x || (strict && midX == x)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+SpatialRange spatialIndexQuery(const SpatialIndex *idx, Rectangle area)
+{
+    float left = area.x;
+    float right = area.x + area.width;
+
+    int first = lowerBound(idx, left - idx->maxWidth, false);
+    int end = lowerBound(idx, right, true);
+
+    // drop the leading rectangles that end before the area starts
+    while (first < end) {
+        const Rectangle *r = spatialIndexRect(idx, first);
+        if (r->x + r->width >= left) {
+            break;
+        }
+        first += 1;
+    }
+
+    return (SpatialRange){.first = first, .count = end - first};
+}
@@ -0,0 +1,34 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <raylib.h>
+#include <stddef.h>
+
+// Interval index over rectangles sorted by their left edge.
+//
+// A query binary searches the first rectangle that can reach the query area
+// (no rectangle is wider than maxWidth) and the last one starting inside it,
+// so the cost is O(log n + k). Results are a contiguous range of the input
+// array, only the x extent is tested so callers that need an exact overlap
+// check it per rectangle.
+typedef struct SpatialIndex {
+    const char *rects; // not owned, rectangle i is at rects + i * stride
+    size_t stride;
+    int len;
+    float maxWidth;
+} SpatialIndex;
+
+typedef struct SpatialRange {
+    int first;
+    int count;
+} SpatialRange;
+
+// rects must be sorted by x and outlive the index
+void spatialIndexBuild(SpatialIndex *idx, const Rectangle *rects, int len);
+// same over records stride bytes apart that each start with a Rectangle
+void spatialIndexBuildStrided(SpatialIndex *idx, const Rectangle *first,
+                              size_t stride, int len);
+const Rectangle *spatialIndexRect(const SpatialIndex *idx, int i);
+SpatialRange spatialIndexQuery(const SpatialIndex *idx, Rectangle area);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Single producer single consumer ring of slot indices.
+//
+// head and tail only ever grow, the slot for a position is position %
+// capacity. The producer owns tail and the consumer owns head, each side only
+// reads the other one so both ends are wait-free. The caller keeps the slot
+// storage, write a slot between spscWriteSlot() and spscPublish(), read it
+// between spscReadSlot() and spscRelease().
+typedef struct SpscRing {
+    _Alignas(64) atomic_size_t head; // next position to read
+    _Alignas(64) atomic_size_t tail; // next position to write
+    size_t capacity;
+} SpscRing;
+
+static inline void spscInit(SpscRing *r, size_t capacity)
+{
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->capacity = capacity;
+}
+
+// producer: slot to write into or false when full
+static inline bool spscWriteSlot(SpscRing *r, size_t *slot)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (tail - head == r->capacity) {
+        return false;
+    }
+    *slot = tail % r->capacity;
+    return true;
+}
+
+static inline void spscPublish(SpscRing *r)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+// consumer: slot to read from or false when empty
+static inline bool spscReadSlot(SpscRing *r, size_t *slot)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *slot = head % r->capacity;
+    return true;
+}
+
+static inline void spscRelease(SpscRing *r)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+// consumer: number of published entries, entry i is at slot
+// spscPeekSlot(r, i)
+static inline size_t spscLen(SpscRing *r)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return tail - head;
+}
+
+static inline size_t spscPeekSlot(SpscRing *r, size_t i)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    return (head + i) % r->capacity;
+}
+
+#endif
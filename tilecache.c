@@ -0,0 +1,196 @@
+#include "tilecache.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#include "alloc.h"
+
+// keep a ring of tiles around the view so small camera moves do not thrash
+#define TILE_POOL_SLACK 2
+
+typedef struct TileSpan {
+    int x0, y0, x1, y1; // inclusive
+} TileSpan;
+
+static float tileWorldSize(const TileCache *c)
+{
+    return c->worldSize > 0 ? (float)c->worldSize : TILE_SIZE;
+}
+
+static TileSpan tilesCovering(const TileCache *c, Rectangle view)
+{
+    float size = tileWorldSize(c);
+    return (TileSpan){
+        .x0 = (int)floorf(view.x / size),
+        .y0 = (int)floorf(view.y / size),
+        .x1 = (int)floorf((view.x + view.width) / size),
+        .y1 = (int)floorf((view.y + view.height) / size),
+    };
+}
+
+static int tileTexels(const TileCache *c)
+{
+    return c->texels > 0 ? c->texels : TILE_SIZE;
+}
+
+static void poolReserve(TileCache *c, int needed)
+{
+    if (c->len >= needed) {
+        return;
+    }
+
+    tileCacheUnload(c);
+    c->tiles = allocMem(ALLOC_RENDER, needed * sizeof(*c->tiles));
+    c->len = needed;
+    for (int i = 0; i < c->len; i += 1) {
+        c->tiles[i].target = LoadRenderTexture(tileTexels(c), tileTexels(c));
+    }
+}
+
+static Tile *tileFind(TileCache *c, int x, int y)
+{
+    for (int i = 0; i < c->len; i += 1) {
+        Tile *t = &c->tiles[i];
+        if (t->valid && t->x == x && t->y == y) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static Tile *tileEvict(TileCache *c)
+{
+    Tile *oldest = NULL;
+    for (int i = 0; i < c->len; i += 1) {
+        Tile *t = &c->tiles[i];
+        if (!t->valid) {
+            return t;
+        }
+        if (t->lastUsed != c->frame &&
+            (oldest == NULL || t->lastUsed < oldest->lastUsed)) {
+            oldest = t;
+        }
+    }
+    return oldest;
+}
+
+static void tileRender(const TileCache *c, Tile *t, int x, int y,
+                       TileDrawFn draw, void *data)
+{
+    float size = tileWorldSize(c);
+    Rectangle area = {(float)x * size, (float)y * size, size, size};
+
+    t->x = x;
+    t->y = y;
+    t->valid = true;
+
+    BeginTextureMode(t->target);
+    ClearBackground(BLANK);
+    BeginMode2D((Camera2D){
+        .target = {area.x, area.y},
+        .zoom = (float)tileTexels(c) / size,
+    });
+    draw(area, data);
+    EndMode2D();
+    EndTextureMode();
+}
+
+void tileCacheUpdateViews(TileCache *c, const Rectangle *views, int count,
+                          TileDrawFn draw, void *data)
+{
+    // room for every view even where they overlap, so no view's tiles are
+    // evicted for another's
+    int visible = 0;
+    for (int i = 0; i < count; i += 1) {
+        TileSpan span = tilesCovering(c, views[i]);
+        visible += (span.x1 - span.x0 + 1) * (span.y1 - span.y0 + 1);
+    }
+    poolReserve(c, visible * TILE_POOL_SLACK);
+
+    c->frame += 1;
+    c->rendered = 0;
+    c->drawn = 0;
+
+    for (int i = 0; i < count; i += 1) {
+        TileSpan span = tilesCovering(c, views[i]);
+        for (int y = span.y0; y <= span.y1; y += 1) {
+            for (int x = span.x0; x <= span.x1; x += 1) {
+                Tile *t = tileFind(c, x, y);
+                if (t == NULL) {
+                    t = tileEvict(c);
+                    tileRender(c, t, x, y, draw, data);
+                    c->rendered += 1;
+                }
+                t->lastUsed = c->frame;
+            }
+        }
+    }
+}
+
+void tileCacheUpdate(TileCache *c, Rectangle view, TileDrawFn draw,
+                     void *data)
+{
+    tileCacheUpdateViews(c, &view, 1, draw, data);
+}
+
+void tileCacheDraw(TileCache *c, Rectangle view)
+{
+    TileSpan span = tilesCovering(c, view);
+    float texels = (float)tileTexels(c);
+    float size = tileWorldSize(c);
+
+    for (int y = span.y0; y <= span.y1; y += 1) {
+        for (int x = span.x0; x <= span.x1; x += 1) {
+            Tile *t = tileFind(c, x, y);
+            if (t == NULL) {
+                continue;
+            }
+
+            // render textures are stored upside down
+            DrawTexturePro(t->target.texture,
+                           (Rectangle){0, 0, texels, -texels},
+                           (Rectangle){(float)x * size, (float)y * size, size,
+                                       size},
+                           (Vector2){0, 0}, 0, WHITE);
+            c->drawn += 1;
+        }
+    }
+}
+
+void tileCacheInvalidate(TileCache *c)
+{
+    for (int i = 0; i < c->len; i += 1) {
+        c->tiles[i].valid = false;
+    }
+}
+
+void tileCacheInvalidateArea(TileCache *c, Rectangle area)
+{
+    TileSpan span = tilesCovering(c, area);
+    for (int i = 0; i < c->len; i += 1) {
+        Tile *t = &c->tiles[i];
+        if (t->x >= span.x0 && t->x <= span.x1 && t->y >= span.y0 &&
+            t->y <= span.y1) {
+            t->valid = false;
+        }
+    }
+}
+
+void tileCacheUnload(TileCache *c)
+{
+    for (int i = 0; i < c->len; i += 1) {
+        UnloadRenderTexture(c->tiles[i].target);
+    }
+    allocFree(c->tiles);
+
+    *c = (TileCache){.texels = c->texels, .worldSize = c->worldSize};
+}
+
+void tileCacheSetTexels(TileCache *c, int texels)
+{
+    if (texels == c->texels) {
+        return;
+    }
+    tileCacheUnload(c);
+    c->texels = texels;
+}
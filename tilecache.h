@@ -0,0 +1,61 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <raylib.h>
+
+// Cache of static world content rendered into square RenderTexture tiles of
+// TILE_SIZE world units, or of worldSize for caches that are only drawn
+// zoomed out.
+//
+// Tiles are rendered lazily the first time they become visible and kept in a
+// pool sized for the view, the least recently drawn tile is reused when the
+// pool is full. Content is drawn through a callback so the cache does not
+// know what it holds, call tileCacheInvalidate() whenever that changes.
+#define TILE_SIZE 512
+
+// draw everything intersecting area, called with a 2D camera already set up
+typedef void (*TileDrawFn)(Rectangle area, void *data);
+
+typedef struct Tile {
+    RenderTexture2D target;
+    int x; // tile coordinates, world position is x times the tile size
+    int y;
+    bool valid;
+    unsigned int lastUsed;
+} Tile;
+
+typedef struct TileCache {
+    Tile *tiles;
+    int len;
+    unsigned int frame;
+    // world units per tile side, TILE_SIZE when 0
+    int worldSize;
+    // texels per tile side, TILE_SIZE when 0, lower trades sharpness for
+    // fill rate
+    int texels;
+
+    // stats for the last update, drawn counts every tileCacheDraw() since
+    int rendered;
+    int drawn;
+} TileCache;
+
+// Render missing tiles for view, must be called outside of BeginMode2D and
+// BeginTextureMode since it switches render targets
+void tileCacheUpdate(TileCache *c, Rectangle view, TileDrawFn draw,
+                     void *data);
+// same for the count views drawn this frame, each is then drawn from the
+// tiles they share with tileCacheDraw()
+void tileCacheUpdateViews(TileCache *c, const Rectangle *views, int count,
+                          TileDrawFn draw, void *data);
+// Draw the tiles covering view under the current 2D camera
+void tileCacheDraw(TileCache *c, Rectangle view);
+
+void tileCacheInvalidate(TileCache *c);
+// only the tiles intersecting area
+void tileCacheInvalidateArea(TileCache *c, Rectangle area);
+// drops the pool when the resolution changes, tiles are rendered again
+void tileCacheSetTexels(TileCache *c, int texels);
+// keeps the resolution and the tile size
+void tileCacheUnload(TileCache *c);
+
+#endif
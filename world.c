@@ -0,0 +1,581 @@
+#include "world.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+
+#include "hash.h"
+#include "level.h"
+#include "profile.h"
+#include "spsc.h"
+
+#define BYTES_PER_QUAD (6 * (2 * sizeof(float) + sizeof(Color)))
+
+// Generator thread, requests go in and finished chunks come back through
+// the two rings. It sleeps while there is nothing to do or no room for the
+// result, both ends wake it after making progress.
+typedef struct ChunkRequest {
+    int index;
+    int slot;
+    const Level *level;
+    uint32_t seed;
+    unsigned int epoch;
+} ChunkRequest;
+
+typedef struct ChunkResult {
+    Chunk chunk;
+    int slot;
+    unsigned int epoch;
+} ChunkResult;
+
+static SpscRing requests;
+static ChunkRequest requestSlots[WORLD_MAX_CHUNKS];
+static SpscRing ready;
+static ChunkResult readySlots[WORLD_MAX_CHUNKS];
+
+static pthread_t generator;
+static bool generatorRunning = false;
+static pthread_mutex_t generatorLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t generatorWake = PTHREAD_COND_INITIALIZER;
+static bool generatorStopping = false;
+
+static void chunkUnload(Chunk *c)
+{
+    quadBatchUnload(&c->batch);
+    c->resident = false;
+    c->pending = false;
+}
+
+// Stand in for GetRandomValue() that only depends on the chunk, n counts the
+// values drawn so far
+static int chunkRandom(uint32_t key, uint32_t *n, int min, int max)
+{
+    uint32_t h = hash32(key + *n * 0x9e3779b9u);
+    *n += 1;
+    return min + (int)(h % (uint32_t)(max - min + 1));
+}
+
+static void chunkFill(Chunk *c, uint32_t seed, int index)
+{
+    uint32_t key = hash32(seed ^ hash32((uint32_t)index));
+    uint32_t n = 0;
+
+    float x = (float)index * CHUNK_WIDTH;
+    float end = x + CHUNK_WIDTH;
+
+    c->len = 0;
+    while (x < end && c->len < CHUNK_MAX_BUILDINGS) {
+        Building *b = &c->storage[c->len];
+        b->rect.width = fminf((float)chunkRandom(key, &n, 50, 200), end - x);
+        b->rect.height =
+            (float)chunkRandom(key, &n, 100, MAX_BUILDING_HEIGHT);
+        b->rect.x = x;
+        b->rect.y = GROUND_Y - b->rect.height;
+
+        b->color = (Color){
+            chunkRandom(key, &n, 200, 240),
+            chunkRandom(key, &n, 200, 240),
+            chunkRandom(key, &n, 200, 250),
+            255,
+        };
+
+        x += b->rect.width;
+        c->len += 1;
+    }
+    c->buildings = c->storage;
+}
+
+// the buildings moved, e.g. after the chunk was copied
+static void chunkIndexBuild(Chunk *c)
+{
+    if (c->buildings == NULL) {
+        c->buildings = c->storage;
+    }
+    spatialIndexBuildStrided(&c->spatial, &c->buildings[0].rect,
+                             sizeof(Building), c->len);
+}
+
+static void chunkSilhouetteBuild(Chunk *c)
+{
+    float x = (float)c->index * CHUNK_WIDTH;
+
+    c->silhouetteLen = 0;
+    for (int i = 0; i < CHUNK_SILHOUETTE_SPANS; i += 1) {
+        float x0 = x + (float)i * CHUNK_SPAN_WIDTH;
+        float x1 = x0 + CHUNK_SPAN_WIDTH;
+
+        const Building *tallest = NULL;
+        for (int j = 0; j < c->len; j += 1) {
+            Rectangle r = c->buildings[j].rect;
+            if (r.x < x1 && r.x + r.width > x0 &&
+                (tallest == NULL || r.y < tallest->rect.y)) {
+                tallest = &c->buildings[j];
+            }
+        }
+        if (tallest == NULL) {
+            continue;
+        }
+
+        Building *last = c->silhouetteLen > 0
+                             ? &c->silhouette[c->silhouetteLen - 1]
+                             : NULL;
+        if (last != NULL && last->rect.x + last->rect.width == x0 &&
+            last->rect.y == tallest->rect.y) {
+            last->rect.width += CHUNK_SPAN_WIDTH;
+            continue;
+        }
+
+        c->silhouette[c->silhouetteLen] = (Building){
+            .rect = {x0, tallest->rect.y, CHUNK_SPAN_WIDTH,
+                     GROUND_Y - tallest->rect.y},
+            .color = tallest->color,
+        };
+        c->silhouetteLen += 1;
+    }
+}
+
+void chunkGenerate(Chunk *c, const Level *level, uint32_t seed, int index)
+{
+    c->index = index;
+    if (level != NULL) {
+        c->buildings = levelChunk(level, index, &c->len);
+    } else {
+        chunkFill(c, seed, index);
+    }
+    // buildings are laid out left to right so they are already sorted
+    chunkIndexBuild(c);
+    chunkSilhouetteBuild(c);
+
+    c->resident = true;
+    c->pending = false;
+}
+
+void chunkBuildBatch(Chunk *c)
+{
+    quadBatchUnload(&c->batch);
+    quadBatchInit(&c->batch, 1 + c->len + c->silhouetteLen);
+    quadBatchAdd(&c->batch,
+                 (Rectangle){(float)c->index * CHUNK_WIDTH, GROUND_Y,
+                             CHUNK_WIDTH, GROUND_DEPTH},
+                 DARKGRAY);
+    for (int i = 0; i < c->len; i += 1) {
+        quadBatchAdd(&c->batch, c->buildings[i].rect, c->buildings[i].color);
+    }
+    for (int i = 0; i < c->silhouetteLen; i += 1) {
+        quadBatchAdd(&c->batch, c->silhouette[i].rect, c->silhouette[i].color);
+    }
+}
+
+static void generatorWakeUp()
+{
+    pthread_mutex_lock(&generatorLock);
+    pthread_cond_signal(&generatorWake);
+    pthread_mutex_unlock(&generatorLock);
+}
+
+static bool generatorHasWork()
+{
+    size_t slot;
+    return spscLen(&requests) > 0 && spscWriteSlot(&ready, &slot);
+}
+
+static void *generatorMain(void *arg)
+{
+    (void)arg;
+
+    while (true) {
+        pthread_mutex_lock(&generatorLock);
+        while (!generatorHasWork() && !generatorStopping) {
+            pthread_cond_wait(&generatorWake, &generatorLock);
+        }
+        bool stopping = generatorStopping;
+        pthread_mutex_unlock(&generatorLock);
+        if (stopping) {
+            return NULL;
+        }
+
+        size_t in;
+        size_t out;
+        while (spscReadSlot(&requests, &in) && spscWriteSlot(&ready, &out)) {
+            ChunkRequest req = requestSlots[in];
+            spscRelease(&requests);
+
+            ChunkResult *r = &readySlots[out];
+            r->chunk = (Chunk){0};
+            chunkGenerate(&r->chunk, req.level, req.seed, req.index);
+            chunkBuildBatch(&r->chunk);
+            r->slot = req.slot;
+            r->epoch = req.epoch;
+            spscPublish(&ready);
+        }
+    }
+}
+
+static bool generatorStart()
+{
+    spscInit(&requests, WORLD_MAX_CHUNKS);
+    spscInit(&ready, WORLD_MAX_CHUNKS);
+    generatorStopping = false;
+    generatorRunning =
+        pthread_create(&generator, NULL, generatorMain, NULL) == 0;
+    return generatorRunning;
+}
+
+static void generatorStop()
+{
+    if (!generatorRunning) {
+        return;
+    }
+
+    pthread_mutex_lock(&generatorLock);
+    generatorStopping = true;
+    pthread_cond_signal(&generatorWake);
+    pthread_mutex_unlock(&generatorLock);
+    pthread_join(generator, NULL);
+    generatorRunning = false;
+
+    // nobody takes these anymore
+    size_t slot;
+    while (spscReadSlot(&ready, &slot)) {
+        quadBatchUnload(&readySlots[slot].chunk.batch);
+        spscRelease(&ready);
+    }
+}
+
+void worldInit(World *w, uint32_t seed)
+{
+    for (int i = 0; i < WORLD_MAX_CHUNKS; i += 1) {
+        chunkUnload(&w->chunks[i]);
+    }
+    // requests still in flight come back with the old epoch and are dropped
+    w->seed = seed;
+    w->epoch += 1;
+    w->pending = 0;
+    w->resident = 0;
+    w->generated = 0;
+    w->changed = false;
+
+    if (w->drainBudgetNs == 0) {
+        w->drainBudgetNs = CHUNK_DRAIN_BUDGET_NS;
+    }
+    if (w->uploadBudget == 0) {
+        w->uploadBudget = CHUNK_UPLOAD_BUDGET;
+    }
+}
+
+void worldUnload(World *w)
+{
+    generatorStop();
+    for (int i = 0; i < WORLD_MAX_CHUNKS; i += 1) {
+        chunkUnload(&w->chunks[i]);
+    }
+    w->pending = 0;
+    w->resident = 0;
+    w->generated = 0;
+}
+
+int chunkIndexAt(float x) { return (int)floorf(x / CHUNK_WIDTH); }
+
+WorldLod worldLodForZoom(float zoom)
+{
+    return zoom < WORLD_LOD_ZOOM ? WORLD_LOD_SILHOUETTE : WORLD_LOD_BUILDINGS;
+}
+
+Chunk *worldChunk(World *w, int index)
+{
+    for (int i = 0; i < WORLD_MAX_CHUNKS; i += 1) {
+        if (w->chunks[i].resident && w->chunks[i].index == index) {
+            return &w->chunks[i];
+        }
+    }
+    return NULL;
+}
+
+// the resident or pending chunk index
+static Chunk *chunkFind(World *w, int index)
+{
+    for (int i = 0; i < WORLD_MAX_CHUNKS; i += 1) {
+        Chunk *c = &w->chunks[i];
+        if ((c->resident || c->pending) && c->index == index) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// a free slot or the least recently used one that is not needed this frame
+static Chunk *chunkSlot(World *w)
+{
+    Chunk *oldest = NULL;
+    for (int i = 0; i < WORLD_MAX_CHUNKS; i += 1) {
+        Chunk *c = &w->chunks[i];
+        if (c->pending) {
+            continue;
+        }
+        if (!c->resident) {
+            return c;
+        }
+        if (c->lastUsed != w->frame &&
+            (oldest == NULL || c->lastUsed < oldest->lastUsed)) {
+            oldest = c;
+        }
+    }
+    return oldest;
+}
+
+static void chunkRequire(World *w, int index)
+{
+    Chunk *c = chunkFind(w, index);
+    if (c == NULL) {
+        size_t slot;
+        if (!generatorRunning || !spscWriteSlot(&requests, &slot)) {
+            return;
+        }
+        c = chunkSlot(w);
+        if (c == NULL) {
+            // more chunks in range than the pool holds
+            return;
+        }
+
+        chunkUnload(c);
+        c->index = index;
+        c->pending = true;
+        w->pending += 1;
+
+        requestSlots[slot] = (ChunkRequest){
+            .index = index,
+            .slot = (int)(c - w->chunks),
+            .level = w->level,
+            .seed = w->seed,
+            .epoch = w->epoch,
+        };
+        spscPublish(&requests);
+        generatorWakeUp();
+    }
+    c->lastUsed = w->frame;
+}
+
+static void chunksReceive(World *w)
+{
+    uint64_t start = profileNowNs();
+    bool received = false;
+
+    size_t slot;
+    while (spscReadSlot(&ready, &slot)) {
+        ChunkResult *r = &readySlots[slot];
+        Chunk *c = &w->chunks[r->slot];
+
+        if (r->epoch != w->epoch || !c->pending ||
+            c->index != r->chunk.index) {
+            quadBatchUnload(&r->chunk.batch);
+        } else {
+            unsigned int lastUsed = c->lastUsed;
+            bool generated = r->chunk.buildings == r->chunk.storage;
+            *c = r->chunk;
+            c->lastUsed = lastUsed;
+            // generated buildings were in the ready slot
+            if (generated) {
+                c->buildings = c->storage;
+            }
+            chunkIndexBuild(c);
+            w->pending -= 1;
+            w->generated += 1;
+
+            Rectangle area = {
+                (float)c->index * CHUNK_WIDTH,
+                GROUND_Y - MAX_BUILDING_HEIGHT,
+                CHUNK_WIDTH,
+                MAX_BUILDING_HEIGHT + GROUND_DEPTH,
+            };
+            if (w->changed) {
+                float x0 = fminf(w->changedArea.x, area.x);
+                float x1 = fmaxf(w->changedArea.x + w->changedArea.width,
+                                 area.x + area.width);
+                area.x = x0;
+                area.width = x1 - x0;
+            }
+            w->changedArea = area;
+            w->changed = true;
+        }
+        spscRelease(&ready);
+        received = true;
+
+        if (profileNowNs() - start > w->drainBudgetNs) {
+            break;
+        }
+    }
+
+    if (received) {
+        // it may have stopped on a full ready ring
+        generatorWakeUp();
+    }
+}
+
+// the chunks overlapping area and one more to each side, from the middle out
+// so the closest chunks are requested first and kept when the pool is too
+// small for all of them
+static void chunksRequire(World *w, Rectangle area)
+{
+    int first = chunkIndexAt(area.x) - 1;
+    int last = chunkIndexAt(area.x + area.width) + 1;
+
+    int middle = first + (last - first) / 2;
+    chunkRequire(w, middle);
+    for (int d = 1; middle - d >= first || middle + d <= last; d += 1) {
+        if (middle - d >= first) {
+            chunkRequire(w, middle - d);
+        }
+        if (middle + d <= last) {
+            chunkRequire(w, middle + d);
+        }
+    }
+}
+
+void worldUpdateAreas(World *w, const Rectangle *areas, int count)
+{
+    if (!generatorRunning && !generatorStart()) {
+        return;
+    }
+
+    // one frame for all areas, so none of them evicts another one's chunks
+    w->frame += 1;
+    w->generated = 0;
+    w->uploadedBytes = 0;
+    w->changed = false;
+
+    chunksReceive(w);
+
+    for (int i = 0; i < count; i += 1) {
+        chunksRequire(w, areas[i]);
+    }
+
+    w->resident = 0;
+    for (int i = 0; i < WORLD_MAX_CHUNKS; i += 1) {
+        w->resident += w->chunks[i].resident;
+    }
+}
+
+void worldUpdate(World *w, Rectangle area) { worldUpdateAreas(w, &area, 1); }
+
+// the silhouette spans intersecting area, there are few enough of them to
+// scan, left to right like the buildings
+static SpatialRange silhouetteQuery(const Chunk *c, Rectangle area)
+{
+    int first = 0;
+    while (first < c->silhouetteLen &&
+           c->silhouette[first].rect.x + c->silhouette[first].rect.width <
+               area.x) {
+        first += 1;
+    }
+    int end = first;
+    while (end < c->silhouetteLen &&
+           c->silhouette[end].rect.x <= area.x + area.width) {
+        end += 1;
+    }
+    return (SpatialRange){.first = first, .count = end - first};
+}
+
+static Rectangle rectangleUnion(Rectangle a, Rectangle b)
+{
+    float x0 = fminf(a.x, b.x);
+    float y0 = fminf(a.y, b.y);
+    float x1 = fmaxf(a.x + a.width, b.x + b.width);
+    float y1 = fmaxf(a.y + a.height, b.y + b.height);
+    return (Rectangle){x0, y0, x1 - x0, y1 - y0};
+}
+
+static bool chunkOverlaps(const Chunk *c, Rectangle area)
+{
+    float x = (float)c->index * CHUNK_WIDTH;
+    return x <= area.x + area.width && x + CHUNK_WIDTH >= area.x;
+}
+
+void worldCull(World *w, const Rectangle *areas, int count, WorldLod lod,
+               WorldVisible *v)
+{
+    v->lod = lod;
+    v->len = 0;
+
+    for (int i = 0; i < WORLD_MAX_CHUNKS; i += 1) {
+        Chunk *c = &w->chunks[i];
+        if (!c->resident) {
+            continue;
+        }
+
+        // the bounds of the areas over this chunk, queried once for all of
+        // them
+        bool any = false;
+        Rectangle bounds = {0};
+        for (int a = 0; a < count; a += 1) {
+            if (!chunkOverlaps(c, areas[a])) {
+                continue;
+            }
+            bounds = any ? rectangleUnion(bounds, areas[a]) : areas[a];
+            any = true;
+        }
+        if (!any) {
+            continue;
+        }
+
+        // at least one upload per frame however small the budget is
+        int bytes = c->batch.len * (int)BYTES_PER_QUAD;
+        if (c->batch.positions != NULL &&
+            (w->uploadedBytes == 0 ||
+             w->uploadedBytes + bytes <= w->uploadBudget)) {
+            quadBatchUpload(&c->batch);
+            w->uploadedBytes += bytes;
+        }
+
+        v->chunks[v->len] = (WorldVisibleChunk){
+            .chunk = c,
+            .range = lod == WORLD_LOD_SILHOUETTE
+                         ? silhouetteQuery(c, bounds)
+                         : spatialIndexQuery(&c->spatial, bounds),
+        };
+        v->len += 1;
+    }
+}
+
+int worldDrawVisible(const WorldVisible *v, Rectangle area)
+{
+    int drawn = 0;
+    for (int i = 0; i < v->len; i += 1) {
+        const Chunk *c = v->chunks[i].chunk;
+        SpatialRange visible = v->chunks[i].range;
+        if (!chunkOverlaps(c, area)) {
+            continue;
+        }
+
+        const Building *buildings = c->buildings;
+        int offset = 1;
+        if (v->lod == WORLD_LOD_SILHOUETTE) {
+            buildings = c->silhouette;
+            offset += c->len;
+        }
+
+        if (c->batch.positions == NULL) {
+            // quad 0 is the ground, buildings and then the silhouette follow
+            // in index order
+            quadBatchDraw(&c->batch, 0, 1);
+            quadBatchDraw(&c->batch, offset + visible.first, visible.count);
+        } else {
+            float x = (float)c->index * CHUNK_WIDTH;
+            DrawRectangleRec((Rectangle){x, GROUND_Y, CHUNK_WIDTH,
+                                         GROUND_DEPTH},
+                             DARKGRAY);
+            for (int j = 0; j < visible.count; j += 1) {
+                int b = visible.first + j;
+                DrawRectangleRec(buildings[b].rect, buildings[b].color);
+            }
+        }
+        drawn += visible.count;
+    }
+    return drawn;
+}
+
+int worldDraw(World *w, Rectangle area, WorldLod lod)
+{
+    WorldVisible v;
+    worldCull(w, &area, 1, lod, &v);
+    return worldDrawVisible(&v, area);
+}
@@ -0,0 +1,150 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "quadbatch.h"
+#include "spatial.h"
+
+// Skyline streamed in fixed width chunks
+//
+// The buildings of a chunk are a pure function of the world seed and the
+// chunk index, or come from a level file when one is set, so chunks can be
+// dropped and generated again at any time.
+// worldUpdate() keeps the chunks around an area resident in a fixed pool and
+// reuses the least recently needed one when it runs out, memory does not
+// grow with the distance travelled.
+//
+// Missing chunks are generated on a background thread, vertex data
+// included, and handed back through a lock-free ready queue that
+// worldUpdate() drains within drainBudgetNs. Uploads are limited to
+// uploadBudget bytes per frame, a chunk that is not uploaded yet is drawn
+// in immediate mode. Only one world streams at a time.
+//
+// Everything but the generator is render thread only.
+//
+// Zoomed out the buildings are drawn at a coarser level of detail, every
+// chunk also keeps its skyline as a silhouette of at most
+// CHUNK_SILHOUETTE_SPANS spans of CHUNK_SPAN_WIDTH, each as tall as the
+// tallest building over it in its colour, neighbours of the same height are
+// merged.
+//
+// Several views of the world in one frame share the work: worldUpdateAreas()
+// streams for all of them at once, and worldCull() queries every chunk's
+// index once for the union of the views, which each view then draws from.
+
+#define CHUNK_WIDTH 2048
+#define CHUNK_MAX_BUILDINGS 48 // buildings are at least 50 wide
+#define WORLD_MAX_CHUNKS 16
+#define GROUND_Y 590.0f // everything below is solid ground
+#define GROUND_DEPTH 8000
+#define MAX_BUILDING_HEIGHT 800
+
+#define CHUNK_SPAN_WIDTH 256
+#define CHUNK_SILHOUETTE_SPANS (CHUNK_WIDTH / CHUNK_SPAN_WIDTH)
+
+#define CHUNK_DRAIN_BUDGET_NS 500000
+#define CHUNK_UPLOAD_BUDGET (64 * 1024)
+
+// also the record layout of level files
+typedef struct Building {
+    Rectangle rect;
+    Color color;
+} Building;
+
+typedef enum WorldLod {
+    WORLD_LOD_BUILDINGS = 0,
+    WORLD_LOD_SILHOUETTE,
+    WORLD_LOD_LEVELS,
+} WorldLod;
+
+// silhouettes below this camera zoom
+#define WORLD_LOD_ZOOM 0.5f
+
+struct Level;
+
+typedef struct Chunk {
+    int index; // the chunk starts at x = index * CHUNK_WIDTH
+    bool resident;
+    bool pending; // being generated, the slot is reserved
+    unsigned int lastUsed;
+
+    // left to right, points at storage or into the level file
+    const Building *buildings;
+    int len;
+    Building storage[CHUNK_MAX_BUILDINGS];
+    SpatialIndex spatial;
+    Building silhouette[CHUNK_SILHOUETTE_SPANS];
+    int silhouetteLen;
+    QuadBatch batch; // ground, buildings then the silhouette
+} Chunk;
+
+typedef struct World {
+    uint32_t seed;
+    const struct Level *level; // replaces generation when set
+    unsigned int epoch; // bumped by worldInit(), older results are dropped
+    Chunk chunks[WORLD_MAX_CHUNKS];
+    unsigned int frame;
+    int pending;
+
+    uint64_t drainBudgetNs;
+    int uploadBudget; // bytes per frame, at least one chunk is uploaded
+    int uploadedBytes;
+
+    // stats for the last update
+    int resident;
+    int generated;
+    // covers the chunks that became resident, whatever was drawn of the
+    // world there before is out of date
+    bool changed;
+    Rectangle changedArea;
+} World;
+
+// drop all chunks and start over with a different seed, keeps the level and
+// the budgets
+void worldInit(World *w, uint32_t seed);
+void worldUnload(World *w);
+
+// fill c with chunk index of the level, or of the world seed without one,
+// touches nothing but c so any thread can generate chunks
+void chunkGenerate(Chunk *c, const struct Level *level, uint32_t seed,
+                   int index);
+// fill the quad batch of a generated chunk, ready for upload
+void chunkBuildBatch(Chunk *c);
+int chunkIndexAt(float x);
+WorldLod worldLodForZoom(float zoom);
+
+// request the chunks overlapping area and one more to each side and take in
+// the ones that finished
+void worldUpdate(World *w, Rectangle area);
+// same for count areas, the earlier ones get the chunks first when the pool
+// is too small for all of them
+void worldUpdateAreas(World *w, const Rectangle *areas, int count);
+// the resident chunk index, NULL when it is not resident
+Chunk *worldChunk(World *w, int index);
+
+// What a set of views shows of the world at one level of detail
+typedef struct WorldVisibleChunk {
+    const Chunk *chunk;
+    SpatialRange range; // of its buildings or silhouette spans
+} WorldVisibleChunk;
+
+typedef struct WorldVisible {
+    WorldLod lod;
+    WorldVisibleChunk chunks[WORLD_MAX_CHUNKS];
+    int len;
+} WorldVisible;
+
+// the resident chunks intersecting any of count areas and what they show of
+// their union, also uploads chunks within the budget
+void worldCull(World *w, const Rectangle *areas, int count, WorldLod lod,
+               WorldVisible *v);
+// draw ground and buildings of v intersecting area under the current 2D
+// camera, returns how many buildings or silhouette spans were drawn
+int worldDrawVisible(const WorldVisible *v, Rectangle area);
+// culls area alone and draws it
+int worldDraw(World *w, Rectangle area, WorldLod lod);
+
+#endif